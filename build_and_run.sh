@@ -13,15 +13,38 @@ echo y > ./fastflow-master/ff/mapping_string.sh
 # List of CPU counts to test
 cpu_counts=(2 4 8 16 20)
 
+# Repeated runs of each dimension (after an untimed one), the results are their median
+benchmark_options="--repetitions=5 --warmup=1"
+
 # Run the sequential application
-./build/sequential
-./build/parallel 1
-mpirun -n 1 ./build/distributed
+./build/sequential ${benchmark_options}
+./build/parallel 1 ${benchmark_options}
+mpirun -n 1 ./build/distributed ${benchmark_options}
 
 # Run the parallel and distributed applications
 for cpus in "${cpu_counts[@]}"; do
-    ./build/parallel "${cpus}"
-    mpirun -n "${cpus}" --oversubscribe ./build/distributed
+    ./build/parallel "${cpus}" ${benchmark_options}
+    mpirun -n "${cpus}" --oversubscribe ./build/distributed ${benchmark_options}
+done
+
+# Run the hybrid application (two processes, each one with half of the threads)
+for cpus in "${cpu_counts[@]}"; do
+    mpirun -n 2 --oversubscribe ./build/hybrid "$((cpus / 2))" ${benchmark_options}
+done
+
+# Run the work-stealing and OpenMP applications (the OpenMP one is only built if OpenMP is available)
+for cpus in "${cpu_counts[@]}"; do
+    ./build/threads "${cpus}" ${benchmark_options}
+    if [ -x ./build/openmp ]; then
+        ./build/openmp "${cpus}" ${benchmark_options}
+        ./build/openmp "${cpus}" taskloop ${benchmark_options}
+    fi
+done
+
+# Run the batch applications (1000 matrices of 256 to 2048 rows)
+for cpus in "${cpu_counts[@]}"; do
+    ./build/batch "${cpus}" 1000 ${benchmark_options}
+    mpirun -n "${cpus}" --oversubscribe ./build/distributed_batch 1000 ${benchmark_options}
 done
 
 python3 ./scripts/plot.py
@@ -13,10 +13,17 @@ echo y > ./fastflow-master/ff/mapping_string.sh
 # List of CPU counts to test
 cpu_counts=(2 4 8 16 20)
 
+# Repeated runs of each dimension (after an untimed one), the results are their median
+benchmark_options="--repetitions=5 --warmup=1"
+
+# List of node counts to test for the hybrid application (one process per node)
+node_counts=(1 2 4 8)
+
 mkdir -p "slurm_scripts"
 mkdir -p "slurm_scripts/sequential"
 mkdir -p "slurm_scripts/parallel"
 mkdir -p "slurm_scripts/distributed"
+mkdir -p "slurm_scripts/hybrid"
 
 # Create SLURM scripts for sequential application
 cat <<EOT > slurm_scripts/sequential/slurm_sequential.sh
@@ -35,9 +42,9 @@ module load gnu12/12.2.0
 module load openmpi4/4.1.5
 
 # Run the sequential application
-srun ./build/sequential
-srun ./build/parallel 1
-srun --mpi=pmix -n 1 ./build/distributed
+srun ./build/sequential ${benchmark_options}
+srun ./build/parallel 1 ${benchmark_options}
+srun --mpi=pmix -n 1 ./build/distributed ${benchmark_options}
 EOT
 
 # Create SLURM scripts for multi-threaded application
@@ -58,7 +65,7 @@ module load gnu12/12.2.0
 module load openmpi4/4.1.5
 
 # Run the multi-threaded application
-srun ./build/parallel ${cpus}
+srun ./build/parallel ${cpus} ${benchmark_options}
 EOT
 done
 
@@ -80,7 +87,29 @@ module load gnu12/12.2.0
 module load openmpi4/4.1.5
 
 # Run the multi-process application
-srun --mpi=pmix -n ${cpus} ./build/distributed
+srun --mpi=pmix -n ${cpus} ./build/distributed ${benchmark_options}
+EOT
+done
+
+# Create SLURM scripts for hybrid application
+for nodes in "${node_counts[@]}"; do
+    cat <<EOT > slurm_scripts/hybrid/slurm_hybrid_"${nodes}".sh
+#!/bin/bash
+#SBATCH --job-name=sz_h_${nodes}                                                  # Job name
+#SBATCH --output=slurm_scripts/hybrid/output_hybrid_${nodes}nodes_%j.txt          # Output file
+#SBATCH --error=slurm_scripts/hybrid/error_hybrid_${nodes}nodes_%j.txt            # Error file
+#SBATCH --nodes=${nodes}                                                          # Number of nodes
+#SBATCH --ntasks-per-node=1                                                       # Number of tasks per node
+#SBATCH --cpus-per-task=20                                                        # Number of CPU cores per task
+#SBATCH --time=01:00:00                                                           # Time limit hrs:min:sec
+#SBATCH --partition=normal                                                        # Partition name
+
+# Load necessary modules
+module load gnu12/12.2.0
+module load openmpi4/4.1.5
+
+# Run the hybrid application
+srun --mpi=pmix -n ${nodes} ./build/hybrid 20 ${benchmark_options}
 EOT
 done
 
@@ -94,5 +123,10 @@ for cpus in "${cpu_counts[@]}"; do
     sbatch --wait slurm_scripts/distributed/slurm_distributed_"${cpus}".sh
 done
 
+for nodes in "${node_counts[@]}"; do
+    chmod +x slurm_scripts/hybrid/slurm_hybrid_"${nodes}".sh
+    sbatch --wait slurm_scripts/hybrid/slurm_hybrid_"${nodes}".sh
+done
+
 python3 ./scripts/plot.py
 python3 ./scripts/statistics.py
@@ -1,3 +1,5 @@
+import glob
+import os
 import matplotlib.pyplot as plt
 import numpy as np
 
@@ -147,3 +149,47 @@ plt.legend()
 plt.grid(True)
 plt.savefig(f'./plots/distributed_scalabilities.png')
 plt.close()
+
+
+# -------------------------- timelines -------------------------- #
+
+# traces of the builds with SPM_INSTRUMENT (see src/utils/instrumentation.h), one row per diagonal and worker
+for trace_file in sorted(glob.glob('./results/*_trace_*.csv')):
+    trace_name = os.path.splitext(os.path.basename(trace_file))[0]
+    trace = np.genfromtxt(trace_file, delimiter=',', skip_header=1, usecols=range(10), ndmin=2)
+    if trace.shape[0] == 0:
+        continue
+    diagonals = trace[:, 0]
+    starts = trace[:, 1]
+    ends = trace[:, 2]
+    workers = trace[:, 7].astype(int)
+    busy_times = trace[:, 8]
+
+    fig, (timeline, rates) = plt.subplots(2, 1, figsize=(16, 10), sharex=True)
+
+    # busy time of each worker at the start of each diagonal, the rest of the diagonal is idle
+    for worker in np.unique(workers):
+        rows = workers == worker
+        timeline.broken_barh(list(zip(starts[rows], ends[rows] - starts[rows])), (worker - 0.4, 0.8),
+                             facecolors='lightgrey')
+        timeline.broken_barh(list(zip(starts[rows], busy_times[rows])), (worker - 0.4, 0.8),
+                             facecolors='tab:blue')
+    timeline.set_ylabel('Worker')
+    timeline.set_yticks(np.unique(workers))
+    timeline.set_title(f'Timeline of {trace_name} (busy in blue, idle in grey)')
+    timeline.grid(True)
+
+    # one point per diagonal
+    _, first_rows = np.unique(diagonals, return_index=True)
+    rates.plot(starts[first_rows], trace[first_rows, 5], label='GFLOP/s')
+    rates.set_xlabel('Time (s)')
+    rates.set_ylabel('GFLOP/s')
+    rates.grid(True)
+    communication = rates.twinx()
+    communication.plot(starts[first_rows], trace[first_rows, 4] / np.maximum(ends - starts, 1e-12)[first_rows],
+                       color='tab:red', label='Communication')
+    communication.set_ylabel('Communication time fraction')
+    fig.legend(loc='upper right')
+
+    fig.savefig(f'./plots/{trace_name}.png')
+    plt.close(fig)
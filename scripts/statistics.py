@@ -11,15 +11,21 @@ distributed_1 = np.genfromtxt(distributed_1_results_file, delimiter=',', skip_he
 
 dimensions = sequential[:, 0]
 dimensions = [int(dimension) for dimension in dimensions]
+# The execution times are the medians of the repetitions, column 4 is their standard deviation
 sequential_times = sequential[:, 1]
 parallel_1_times = parallel_1[:, 1]
 distributed_1_times = distributed_1[:, 1]
+sequential_stddevs = sequential[:, 4]
+parallel_1_stddevs = parallel_1[:, 4]
+distributed_1_stddevs = distributed_1[:, 4]
 
 speedups = []
 efficiencies = []
 scalabilities = []
 parallel_p_all_times = []
 distributed_d_all_times = []
+parallel_p_all_stddevs = []
+distributed_d_all_stddevs = []
 
 total_workers = [2, 4, 8, 16, 20]
 for workers in total_workers:
@@ -30,6 +36,8 @@ for workers in total_workers:
     distributed_d_times = distributed_p[:, 1]
     parallel_p_all_times.append(parallel_p_times)
     distributed_d_all_times.append(distributed_d_times)
+    parallel_p_all_stddevs.append(parallel_p[:, 4])
+    distributed_d_all_stddevs.append(distributed_p[:, 4])
 
     parallel_speedup = sequential_times / parallel_p_times
     distributed_speedup = sequential_times / distributed_d_times
@@ -55,10 +63,16 @@ distributed_scalabilities = [scalability[1] for scalability in scalabilities]
 for i, dimension in zip(range(len(dimensions)), dimensions):
     statistics = {'sequential execution time (s)': float(sequential_times[i]),
                   'parallel 1 worker execution time (s)': float(parallel_1_times[i]),
-                  'distributed 1 worker execution time (s)': float(distributed_1_times[i])}
+                  'distributed 1 worker execution time (s)': float(distributed_1_times[i]),
+                  'sequential execution time stddev (s)': float(sequential_stddevs[i]),
+                  'parallel 1 worker execution time stddev (s)': float(parallel_1_stddevs[i]),
+                  'distributed 1 worker execution time stddev (s)': float(distributed_1_stddevs[i])}
     for j, workers in zip(range(len(total_workers)), total_workers):
         statistics[f'parallel {workers} workers execution time (s)'] = float(parallel_p_all_times[j][i])
         statistics[f'distributed {workers} workers execution time (s)'] = float(distributed_d_all_times[j][i])
+        statistics[f'parallel {workers} workers execution time stddev (s)'] = float(parallel_p_all_stddevs[j][i])
+        statistics[f'distributed {workers} workers execution time stddev (s)'] = \
+            float(distributed_d_all_stddevs[j][i])
         statistics[f'parallel {workers} workers speedup'] = float(parallel_speedups[j][i])
         statistics[f'distributed {workers} workers speedup'] = float(distributed_speedups[j][i])
         statistics[f'parallel {workers} workers efficiency'] = float(parallel_efficiencies[j][i])
@@ -0,0 +1,110 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <ff/ff.hpp>
+
+#include "../utils/timer.h"
+#include "../utils/benchmark.h"
+#include "../utils/tuning.h"
+
+#include "autotune.h"
+#include "ffmatrix.h"
+
+/**
+ * \brief A sweep of a matrix timed by the autotuner, with the settings of the tuning profile for its size.
+ */
+enum class Sweep {
+    Wavefront, ///< set_upper_diagonals() with register blocking.
+    Unblocked, ///< set_upper_diagonals() without register blocking, where the prefetch distance matters.
+    Dataflow ///< set_upper_diagonals_dataflow(), where the tile size matters.
+};
+
+/**
+ * \brief Measure the median execution time of a sweep with some settings.
+ * \param dimension The size of the matrix.
+ * \param tuned The settings, set in the tuning profile before constructing the matrix.
+ * \param sweep The sweep.
+ * \param options The options of the benchmark.
+ * \return The median execution time.
+ */
+static double measure(const long dimension, const TuningSettings& tuned, const Sweep sweep,
+                      const BenchmarkOptions& options) {
+    TuningProfile::get().set(dimension, tuned);
+    const FFMatrix matrix{dimension};
+    return summarize(repeat(options, [&]() {
+        return measureExecutionTime([&]() {
+            if (sweep == Sweep::Dataflow)
+                matrix.set_upper_diagonals_dataflow();
+            else
+                matrix.set_upper_diagonals(0, sweep == Sweep::Wavefront);
+        });
+    })).median;
+}
+
+/**
+ * \brief Search the best value of one setting, the others fixed, and keep it in the settings.
+ * \param dimension The size of the matrix.
+ * \param tuned The settings, updated with the best value.
+ * \param setting The setting to search.
+ * \param name The name of the setting.
+ * \param candidates The values to try.
+ * \param sweep The sweep to time.
+ * \param options The options of the benchmark.
+ * \param rows The rows of the results, one per value tried.
+ */
+static void search(const long dimension, TuningSettings& tuned, long TuningSettings::* const setting,
+                   const std::string& name, const std::vector<long>& candidates, const Sweep sweep,
+                   const BenchmarkOptions& options, std::vector<std::vector<std::string>>& rows) {
+    double best_time = 0.0;
+    long best = tuned.*setting;
+    for (const long candidate : candidates) {
+        TuningSettings trial = tuned;
+        trial.*setting = candidate;
+        const double time = measure(dimension, trial, sweep, options);
+        rows.push_back({std::to_string(dimension), name, std::to_string(candidate), toCSVField(time)});
+        if (best_time == 0.0 || time < best_time) {
+            best_time = time;
+            best = candidate;
+        }
+    }
+    tuned.*setting = best;
+}
+
+bool autotune(const std::string& path, const BenchmarkOptions& options) {
+    const long cores = ff::ff_realNumCores();
+    std::vector<long> worker_candidates;
+    for (long nw = 1; nw < cores; nw *= 2) {
+        worker_candidates.push_back(nw);
+    }
+    worker_candidates.push_back(cores);
+
+    std::vector<std::vector<std::string>> rows;
+    for (const long dimension : options.dimensions) {
+        std::cout << "Tuning dimension " << dimension << "..." << std::endl;
+
+        // One setting at a time, each one on the sweep it affects, with the best values found so far
+        TuningSettings tuned;
+        search(dimension, tuned, &TuningSettings::workers, "Workers", worker_candidates, Sweep::Wavefront, options,
+               rows);
+        search(dimension, tuned, &TuningSettings::chunk, "Chunk", {8, 16, 32, 64}, Sweep::Wavefront, options, rows);
+        search(dimension, tuned, &TuningSettings::prefetch_distance, "Prefetch Distance", {0, 1, 2, 4, 8},
+               Sweep::Unblocked, options, rows);
+        search(dimension, tuned, &TuningSettings::tile_size, "Tile Size", {32, 64, 128, 256}, Sweep::Dataflow, options,
+               rows);
+        TuningProfile::get().set(dimension, tuned);
+
+        std::cout << "Dimension " << dimension << ": " << tuned.workers << " workers, chunks of " << tuned.chunk
+                  << " rows, prefetch distance " << tuned.prefetch_distance << ", " << tuned.tile_size << "x"
+                  << tuned.tile_size << " tiles" << std::endl;
+    }
+
+    writeCSV<std::string>("autotune.csv", {"Dimension", "Setting", "Value", "Execution Time"}, rows);
+    try {
+        TuningProfile::get().write(path);
+    } catch (const std::runtime_error& e) {
+        std::cerr << e.what() << ": " << path << std::endl;
+        return false;
+    }
+    std::cout << "Tuning profile written to " << path << std::endl;
+    return true;
+}
\ No newline at end of file
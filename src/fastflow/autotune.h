@@ -0,0 +1,10 @@
+#ifndef SPM_AUTOTUNE_H
+#define SPM_AUTOTUNE_H
+
+#include <string>
+
+#include "../utils/benchmark.h"
+
+bool autotune(const std::string&, const BenchmarkOptions&);
+
+#endif //SPM_AUTOTUNE_H
\ No newline at end of file
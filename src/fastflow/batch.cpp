@@ -0,0 +1,84 @@
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../utils/timer.h"
+#include "../utils/benchmark.h"
+
+#include "batch.h"
+#include "ffbatch.h"
+#include "../sequential/seqmatrix.h"
+
+/**
+ * \brief Compute a batch of matrices, measuring the execution time.
+ * \param batch The batch executor.
+ * \param items The matrices of the batch.
+ * \param checksums The checksums of the matrices.
+ * \return The execution time.
+ */
+template <typename T>
+static double compute(const FFBatch<T>& batch, const std::vector<BatchItem>& items, std::vector<double>& checksums) {
+    return measureExecutionTime([&]() {
+        batch.compute(items, [&checksums](const std::size_t index, const Matrix<T>& matrix) {
+            checksums[index] = matrix.checksum();
+        });
+    });
+}
+
+bool test_batch(const long maxnw, const long count, const long parallel_size, const Precision precision,
+                const BenchmarkOptions& options) {
+    const long nw = maxnw <= 0 ? ff::ff_realNumCores() : maxnw;
+    const std::string name = "batch_" + std::to_string(maxnw) + (precision == Precision::Float ? "_float" : "") +
+                             band_suffix(options);
+    std::string sizes;
+    for (const long dimension : options.dimensions) {
+        sizes += (sizes.empty() ? "" : ";") + std::to_string(dimension);
+    }
+    BenchmarkReport report{name, "fastflow-batch", nw, options,
+                           {{"Sizes", sizes}, {"Parallel Size", std::to_string(parallel_size)},
+                            {"Precision", to_string(precision)}}};
+    bool valid = true;
+
+    std::cout << "Processing a batch of " << count << " matrices in " << to_string(precision) << " with " << maxnw
+              << " threads..." << std::endl;
+
+    const std::vector<BatchItem> items = make_batch(options.dimensions, count, options.diagonals);
+    std::vector<double> checksums(items.size());
+    std::vector<double> times;
+    if (precision == Precision::Float) {
+        const FFBatch<float> batch{maxnw, parallel_size};
+        times = repeat(options, [&]() { return compute(batch, items, checksums); });
+    } else {
+        const FFBatch batch{maxnw, parallel_size};
+        times = repeat(options, [&]() { return compute(batch, items, checksums); });
+    }
+
+    double checksum = 0.0;
+    for (const double value : checksums) {
+        checksum += value;
+    }
+    std::vector<BenchmarkReport::Field> fields{
+            {"Matrices per Second", toCSVField(static_cast<double>(count) / summarize(times).median)}};
+
+    if (options.check) {
+        // One reference for each size of the batch
+        std::map<long, double> references;
+        double reference = 0.0;
+        for (const BatchItem& item : items) {
+            if (references.count(item.size) == 0) {
+                const SeqMatrix matrix{item.size, {}, {}, item.diagonals};
+                matrix.set_upper_diagonals();
+                references[item.size] = matrix.checksum();
+            }
+            reference += references[item.size];
+        }
+        const bool matches = check_checksum(count, checksum, reference, precision);
+        fields.emplace_back("Checksum Check", matches ? "ok" : "mismatch");
+        valid = matches;
+    }
+
+    report.add_batch(count, times, checksum, std::move(fields));
+    report.write();
+    return valid;
+}
\ No newline at end of file
@@ -0,0 +1,8 @@
+#ifndef SPM_BATCH_H
+#define SPM_BATCH_H
+
+#include "../utils/benchmark.h"
+
+bool test_batch(long, long, long, Precision, const BenchmarkOptions&);
+
+#endif //SPM_BATCH_H
\ No newline at end of file
@@ -0,0 +1,149 @@
+#ifndef SPM_FFBATCH_H
+#define SPM_FFBATCH_H
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include <ff/ff.hpp>
+
+#include "ffmatrix.h"
+#include "../sequential/seqmatrix.h"
+#include "../utils/batch_item.h"
+
+/**
+ * \brief A class to compute batches of independent matrices in parallel (using FastFlow).
+ * The large matrices are computed one after the other, each one in parallel by all the workers (see FFMatrix);
+ * the others are scheduled on demand to a farm of workers, each one computing a whole matrix sequentially
+ * (see SeqMatrix), which avoids the barriers between the diagonals that dominate the small matrices.
+ * \tparam T The type of the stored elements (double or float).
+ */
+template <typename T = double>
+class FFBatch {
+
+public:
+
+    /**
+     * \brief A function called with the index of each matrix in the batch and the computed matrix, before it is
+     * destroyed. It can be called by many workers at the same time.
+     */
+    using Consumer = std::function<void(std::size_t, const Matrix<T>&)>;
+
+    /**
+     * \brief Constructor.
+     * \param maxnw The number of workers (default is 0, which means auto-detect).
+     * \param parallel_size The size from which a matrix is computed in parallel by all the workers (default is 4096).
+     */
+    explicit FFBatch(const long maxnw = 0, const long parallel_size = 4096) :
+    nw{(maxnw <= 0) ? static_cast<long>(ff::ff_realNumCores()) : maxnw},
+    parallel_size{parallel_size}
+    {}
+
+    /**
+     * \brief Compute the upper diagonals of all the matrices of a batch.
+     * \param items The matrices of the batch.
+     * \param consume The function called with each computed matrix.
+     */
+    void compute(const std::vector<BatchItem>& items, const Consumer& consume) const {
+        std::vector<std::size_t> order = batch_order(items);
+        const auto small = std::find_if(order.begin(), order.end(), [&](const std::size_t index) {
+            return items[index].size < parallel_size;
+        });
+
+        // The large matrices, with the parallelism inside the matrix
+        for (auto index = order.begin(); index != small; ++index) {
+            const FFMatrix<T> matrix{items[*index].size, items[*index].diagonal, {}, items[*index].diagonals};
+            matrix.set_upper_diagonals(nw);
+            consume(*index, matrix);
+        }
+        if (small == order.end()) return;
+
+        // The small matrices, one per worker
+        std::vector<std::unique_ptr<ff::ff_node>> workers;
+        for (long w = 0; w < nw; ++w) {
+            workers.push_back(std::make_unique<BatchWorker>(items, consume));
+        }
+
+        BatchEmitter emitter{&*small, static_cast<std::size_t>(order.end() - small)};
+        ff::ff_Farm<std::size_t> farm{std::move(workers)};
+        farm.add_emitter(emitter);
+        farm.remove_collector();
+        farm.set_scheduling_ondemand();
+
+        if (farm.run_and_wait_end() < 0) {
+            throw std::runtime_error("Could not run the FastFlow farm");
+        }
+    }
+
+private:
+
+    const long nw; ///< The number of workers.
+    const long parallel_size; ///< The size from which a matrix is computed in parallel by all the workers.
+
+    /**
+     * \brief The emitter of the batch farm, sending the indices of the matrices in scheduling order.
+     */
+    class BatchEmitter final : public ff::ff_monode_t<std::size_t> {
+
+    public:
+
+        /**
+         * \brief Constructor.
+         * \param indices The indices of the matrices, in scheduling order.
+         * \param count The number of matrices.
+         */
+        BatchEmitter(std::size_t* const indices, const std::size_t count) : indices{indices}, count{count} {}
+
+        /**
+         * \brief Send all the matrices at start-up.
+         * \return EOS, the workers stop when they have computed all the matrices.
+         */
+        std::size_t* svc(std::size_t*) override {
+            for (std::size_t i = 0; i < count; ++i) {
+                this->ff_send_out(&indices[i]);
+            }
+            return this->EOS;
+        }
+
+    private:
+
+        std::size_t* const indices; ///< The indices of the matrices, in scheduling order.
+        const std::size_t count; ///< The number of matrices.
+    };
+
+    /**
+     * \brief A worker of the batch farm, computing the matrices it receives.
+     */
+    class BatchWorker final : public ff::ff_node_t<std::size_t> {
+
+    public:
+
+        /**
+         * \brief Constructor.
+         * \param items The matrices of the batch.
+         * \param consume The function called with each computed matrix.
+         */
+        BatchWorker(const std::vector<BatchItem>& items, const Consumer& consume) : items{items}, consume{consume} {}
+
+        /**
+         * \brief Compute a matrix and pass it to the consumer.
+         * \param index The index of the matrix in the batch.
+         * \return GO_ON, nothing is sent back.
+         */
+        std::size_t* svc(std::size_t* index) override {
+            const SeqMatrix<T> matrix{items[*index].size, items[*index].diagonal, {}, items[*index].diagonals};
+            matrix.set_upper_diagonals();
+            consume(*index, matrix);
+            return this->GO_ON;
+        }
+
+    private:
+
+        const std::vector<BatchItem>& items; ///< The matrices of the batch.
+        const Consumer& consume; ///< The function called with each computed matrix.
+    };
+};
+
+#endif //SPM_FFBATCH_H
\ No newline at end of file
@@ -1,90 +1,546 @@
 #ifndef SPM_FFMATRIX_H
 #define SPM_FFMATRIX_H
 
-#include <immintrin.h>
+#include <algorithm>
 #include <cmath>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include <ff/ff.hpp>
 #include <ff/parallel_for.hpp>
 
 #include "../utils/matrix.h"
+#include "../utils/numa.h"
+#include "schedule.h"
 
 /**
  * \brief A class to represent an upper triangular matrix with parallel computation (using FastFlow) of the upper diagonals.
+ * \tparam T The type of the stored elements (double or float).
+ * \tparam Cell The recurrence of the upper diagonals (see Matrix).
  */
-class FFMatrix final : public Matrix {
+template <typename T = double, typename Cell = CbrtDotProduct>
+class FFMatrix final : public Matrix<T, Cell> {
+
+protected:
+
+    using Matrix<T, Cell>::size;
+    using Matrix<T, Cell>::diagonals;
+    using Matrix<T, Cell>::index;
+    using Matrix<T, Cell>::transposed_index;
+    using Matrix<T, Cell>::last_column;
+    using Matrix<T, Cell>::first_row;
+    using Matrix<T, Cell>::start_sweep;
+    using Matrix<T, Cell>::begin_diagonal;
+    using Matrix<T, Cell>::diagonal_done;
+    using Matrix<T, Cell>::finish_sweep;
+    using Matrix<T, Cell>::first_band_diagonal;
+    using Matrix<T, Cell>::tile_column_done;
+    using Matrix<T, Cell>::require_whole_triangle;
+    using Matrix<T, Cell>::set_main_diagonal;
+    using Matrix<T, Cell>::affected_chunks;
+    using Matrix<T, Cell>::mark_computed;
+    using Matrix<T, Cell>::is_computed;
+    using Matrix<T, Cell>::missing_chunks;
+    using Matrix<T, Cell>::cone_computed;
+    using Matrix<T, Cell>::compute_diagonal_chunk;
+    using Matrix<T, Cell>::compute_strips;
+    using Matrix<T, Cell>::compute_band_chunk;
+    using Matrix<T, Cell>::compute_tile;
+    using Matrix<T, Cell>::instrumentation;
+    using Matrix<T, Cell>::data_storage;
+    using Matrix<T, Cell>::data_t_storage;
+    using Matrix<T, Cell>::initialize_rows;
+    using Matrix<T, Cell>::tuning;
 
 public:
 
     /**
      * \brief Constructor to initialize the FastFlow matrix with a given size.
+     * With a NUMA policy, the rows are dealt to the workers in blocks of cbrt_batch_size in round-robin order,
+     * and each worker, pinned to its core, initializes the rows it owns and computes them in all the diagonals.
+     * \param size The size of the matrix (number of rows and columns).
+     * \param numa_policy The placement of the rows on the NUMA nodes (default is no placement).
+     * \param maxnw The number of workers that own the rows with a NUMA policy, the sweeps must use the same one
+     * (default is 0, which means the one of the tuning profile, or auto-detect).
+     * \param diagonals The number of upper diagonals stored and computed (default is 0, which means all of them).
+     */
+    explicit FFMatrix(const long size, const NumaPolicy numa_policy = NumaPolicy::Default, const long maxnw = 0,
+                      const long diagonals = 0) :
+    Matrix<T, Cell>(size, numa_policy == NumaPolicy::Default, {}, diagonals),
+    numa_policy{numa_policy},
+    numa_workers{worker_count(maxnw)}
+    {
+        if (numa_policy == NumaPolicy::Default) return;
+
+        const NumaTopology& topology = NumaTopology::get();
+        if (numa_policy == NumaPolicy::Interleave) {
+            data_storage.interleave(topology.node_list());
+            data_t_storage.interleave(topology.node_list());
+        }
+
+        // Each worker binds (with the bind policy) and writes first the pages of its rows and of their transposes
+        ff::ParallelFor pf{numa_workers, true, true};
+        for_each_owned_block(pf, size, [&](const long worker, const long first, const long last) {
+            if (numa_policy == NumaPolicy::Bind) {
+                data_storage.bind(index(first, first), index(last - 1, last_column(last - 1)) + 1,
+                                  topology.node(worker));
+                data_t_storage.bind(transposed_index(first, first_row(first)), transposed_index(last - 1, last - 1) + 1,
+                                    topology.node(worker));
+            }
+            initialize_rows(first, last);
+        });
+    }
+
+    /**
+     * \brief Constructor to initialize the FastFlow matrix with a given main diagonal, without NUMA placement.
      * \param size The size of the matrix (number of rows and columns).
+     * \param diagonal The main diagonal, size elements (empty for the default one).
+     * \param cell The cell of the recurrence (default is a default-constructed one).
+     * \param diagonals The number of upper diagonals stored and computed (default is 0, which means all of them).
      */
-    explicit FFMatrix(const long size) : Matrix(size) {}
+    FFMatrix(const long size, const std::vector<double>& diagonal, const Cell& cell = {}, const long diagonals = 0) :
+    Matrix<T, Cell>(size, diagonal, cell, diagonals),
+    numa_policy{NumaPolicy::Default},
+    numa_workers{worker_count(0)}
+    {}
 
     /**
      * \brief Set the upper diagonals of the matrix in parallel.
      * Each element of the upper diagonals is the cubic root of the dot product of the corresponding row and column.
-     * \param maxnw The maximum number of workers (default is 0, which means auto-detect).
+     * With register blocking, the diagonals from strip_width on are computed in bands of strip_width diagonals,
+     * as in SeqMatrix::set_upper_diagonals(), with one more parallel loop per band for the partial sums.
+     * The cubic roots are computed in chunks of consecutive elements of a diagonal, one batch per chunk.
+     * With adaptive scheduling, each loop is scheduled from its estimated work (see schedule_diagonal()): the cheap
+     * diagonals are computed on the calling thread, the others by as many workers as they keep busy, with static or
+     * dynamic chunks. The chosen schedules are logged (see get_schedule_log()).
+     * With SPM_INSTRUMENT, each diagonal is traced with the work of each worker (see get_instrumentation()).
+     * With a NUMA policy, each worker computes the blocks of rows it owns, so the schedule is not adapted.
+     * The chunks, the prefetch distance and the default number of workers are the ones of the tuning profile.
+     * \param maxnw The maximum number of workers (default is 0, which means the one of the tuning profile or
+     * auto-detect, or the owners of the rows with a NUMA policy).
+     * \param register_blocking Whether to compute the diagonals in bands with the strip kernel (default is true).
+     * \param cbrt_mode The accuracy of the cubic roots (default is exact).
+     * \param adaptive Whether to schedule each diagonal from its work, otherwise all the workers compute static
+     * chunks of rows on all the diagonals (default is true).
      */
-    void set_upper_diagonals(const long maxnw = 0) const {
-        ff::ParallelFor pf = (maxnw <= 0) ? ff::ParallelFor{true, true} : ff::ParallelFor{maxnw, true, true};
+    void set_upper_diagonals(const long maxnw = 0, const bool register_blocking = true,
+                             const CbrtMode cbrt_mode = CbrtMode::Exact, const bool adaptive = true) const {
+        const bool placed = numa_policy != NumaPolicy::Default;
+        if (placed && maxnw > 0 && maxnw != numa_workers) {
+            throw std::invalid_argument("The number of workers must be the one of the NUMA placement");
+        }
+        const long nw = placed ? numa_workers : worker_count(maxnw);
+        ff::ParallelFor pf{nw, true, true};
+        const long first_band = first_band_diagonal(register_blocking);
+
+        // The schedule of a loop: the blocks of the owners, or chunks small enough to keep all the workers busy on
+        // the last diagonals without adaptive scheduling
+        const auto schedule = [&](const long k, const long rows, const long length, const bool strips) {
+            const DiagonalSchedule chosen = placed ? DiagonalSchedule{nw, Chunking::Static, tuning.chunk}
+                                          : adaptive ? schedule_diagonal(rows, length, nw, tuning.chunk)
+                                          : DiagonalSchedule{nw, Chunking::Static,
+                                                             std::clamp((rows + nw - 1) / nw, 1L, tuning.chunk)};
+            schedule_log.record(k, strips, chosen);
+            return chosen;
+        };
+        schedule_log.clear();
+        start_sweep();
 
         // Iterate over upper diagonals
-        for (long k = 1; k < size; ++k) {
+        for (long k = 1; k < first_band; ++k) {
+            begin_diagonal(k);
+
+            // Iterate over chunks of rows in parallel.
+            parallel_for_rows(pf, size - k, schedule(k, size - k, k, false), [&](const long first, const long last) {
+                const auto work = instrumentation.work();
+                compute_diagonal_chunk(k, first, last, cbrt_mode);
+            });
+            instrumentation.end_diagonal(size - k, k);
+            diagonal_done(k);
 
-            // Iterate over rows in parallel.
-            pf.parallel_for_static(0, size - k, 1, 0, [&](const long i) {
+        }
 
-                // Try to prefetch the next iteration first two 4 double vectors (row and column) into L3 cache
+        // Iterate over the bands of upper diagonals
+        std::vector<double> partial_sums(std::max(size - first_band, 0L) * strip_width);
+        for (long k = first_band; k <= diagonals; k += strip_width) {
+            const long band = std::min(strip_width, diagonals + 1 - k);
+            begin_diagonal(k);
 
-                // first element of the row and column
-                if (i + 1 + k and i + 2 < size - k) {
-                    _mm_prefetch(&data[index(i + 1, i + 2)], _MM_HINT_T2);
-                    _mm_prefetch(&data_t[index(i + 1 + k, i + 1)], _MM_HINT_T2);
-                }
-                // second element of the row and column
-                if (i + 1 + k and i + 3 < size - k) {
-                    _mm_prefetch(&data[index(i + 1, i + 3)], _MM_HINT_T2);
-                    _mm_prefetch(&data_t[index(i + 1 + k, i + 2)], _MM_HINT_T2);
-                }
-                // third element of the row and column
-                if (i + 1 + k and i + 4 < size - k) {
-                    _mm_prefetch(&data[index(i + 1, i + 4)], _MM_HINT_T2);
-                    _mm_prefetch(&data_t[index(i + 1 + k, i + 3)], _MM_HINT_T2);
+            // Iterate over rows in parallel, computing the partial sums of the band (traced with its first diagonal)
+            const DiagonalSchedule strips = schedule(k, size - k, band * (k - band + 1), true);
+            parallel_for_rows(pf, size - k, strips, [&](const long first, const long last) {
+                const auto work = instrumentation.work();
+                compute_strips(k, band, first, last, partial_sums.data());
+            });
+
+            // Iterate over the diagonals of the band and their chunks of rows in parallel
+            for (long s = 0; s < band; ++s) {
+                const long rows = size - k - s;
+                if (s > 0) begin_diagonal(k + s);
+                // All the diagonals of the band have about the same cost per element, mostly the cubic root
+                parallel_for_rows(pf, rows, schedule(k + s, rows, band, false),
+                                  [&](const long first, const long last) {
+                    const auto work = instrumentation.work();
+                    compute_band_chunk(k, s, band, first, last, partial_sums.data(), cbrt_mode);
+                });
+                instrumentation.end_diagonal(rows, band_dot_product_length(k, s, band));
+                diagonal_done(k + s);
+            }
+        }
+        finish_sweep();
+    }
+
+    /**
+     * \brief Change some elements of the main diagonal and recompute in parallel the elements of the upper diagonals
+     * that depend on them, in place, as SeqMatrix::update_main_diagonal().
+     * The affected chunks of rows of each diagonal are computed by compute_chunks(); with a NUMA policy the workers
+     * compute them regardless of the owners of the rows.
+     * \param update The changed elements of the main diagonal.
+     * \param maxnw The maximum number of workers (default is 0, which means the one of the tuning profile or
+     * auto-detect, or the owners of the rows with a NUMA policy).
+     * \param cbrt_mode The accuracy of the cubic roots (default is exact).
+     * \throw std::invalid_argument if a row is out of the matrix.
+     */
+    void update_main_diagonal(const typename Matrix<T, Cell>::DiagonalUpdate& update, const long maxnw = 0,
+                              const CbrtMode cbrt_mode = CbrtMode::Exact) const {
+        const std::vector<long> changed = set_main_diagonal(update);
+        if (changed.empty()) return;
+
+        const long nw = numa_policy != NumaPolicy::Default ? numa_workers : worker_count(maxnw);
+        ff::ParallelFor pf{nw, true, true};
+        for (long k = 1; k <= diagonals; ++k) {
+            compute_chunks(pf, nw, k, affected_chunks(changed, k), cbrt_mode);
+        }
+    }
+
+    /**
+     * \brief Evaluate an element lazily, as SeqMatrix::evaluate(), computing in parallel the chunks of each diagonal
+     * of its dependency cone that are not computed yet (scheduled as in update_main_diagonal()).
+     * \param row The row of the element.
+     * \param column The column of the element (column >= row).
+     * \param maxnw The maximum number of workers (default is 0, which means the one of the tuning profile or
+     * auto-detect, or the owners of the rows with a NUMA policy).
+     * \param cbrt_mode The accuracy of the cubic roots (default is exact).
+     * \return The element, widened to double.
+     * \throw std::invalid_argument if the element is not in the upper triangle, or not in its band.
+     */
+    [[nodiscard]] double evaluate(const long row, const long column, const long maxnw = 0,
+                                  const CbrtMode cbrt_mode = CbrtMode::Exact) const {
+        if (is_computed(row, column)) return this->get(row, column);
+
+        const long nw = numa_policy != NumaPolicy::Default ? numa_workers : worker_count(maxnw);
+        ff::ParallelFor pf{nw, true, true};
+        for (long k = 1; k <= column - row; ++k) {
+            compute_chunks(pf, nw, k, missing_chunks(row, column, k), cbrt_mode);
+        }
+        cone_computed(row, column);
+        return this->get(row, column);
+    }
+
+    /**
+     * \brief Get the schedules chosen by the last call to set_upper_diagonals().
+     * \return The log of the schedules.
+     */
+    [[nodiscard]] const ScheduleLog& get_schedule_log() const {
+        return schedule_log;
+    }
+
+    /**
+     * \brief Set the upper diagonals of the matrix in parallel, tile by tile.
+     * The upper triangle is split into square tiles (triangular on the main diagonal) and the diagonals of tiles are
+     * computed one after the other, with the tiles of the same diagonal computed in parallel.
+     * The result is the same as set_upper_diagonals() up to floating-point rounding.
+     * \param maxnw The maximum number of workers (default is 0, which means the one of the tuning profile or
+     * auto-detect).
+     * \param tile_size The number of rows and columns of a tile (default is 0, which means the one of the tuning
+     * profile).
+     * \throw std::invalid_argument if the matrix only holds a band of the triangle.
+     */
+    void set_upper_diagonals_tiled(const long maxnw = 0, long tile_size = 0) const {
+        require_whole_triangle();
+        if (tile_size <= 0) tile_size = tuning.tile_size;
+        ff::ParallelFor pf{worker_count(maxnw), true, true};
+        const long tiles = (size + tile_size - 1) / tile_size;
+
+        // Iterate over the diagonals of tiles
+        for (long d = 0; d < tiles; ++d) {
+
+            // Iterate over the tiles of the diagonal in parallel.
+            pf.parallel_for_static(0, tiles - d, 1, 0, [&](const long tile_row) {
+                thread_local std::vector<double> partial_sums;
+                partial_sums.resize(tile_size * tile_size);
+                compute_tile(tile_row, tile_row + d, tile_size, partial_sums.data());
+            });
+
+            // The top tile of the column d was in this diagonal of tiles
+            tile_column_done(d, tile_size);
+
+        }
+        mark_computed();
+    }
+
+    /**
+     * \brief Set the upper diagonals of the matrix in parallel, tile by tile, without barriers.
+     * The upper triangle is split into square tiles (triangular on the main diagonal) that are scheduled by a FastFlow
+     * master-worker farm: each tile is sent to an idle worker as soon as the tiles on its left and below it are done.
+     * The result is the same as set_upper_diagonals() up to floating-point rounding.
+     * \param maxnw The maximum number of workers (default is 0, which means the one of the tuning profile or
+     * auto-detect).
+     * \param tile_size The number of rows and columns of a tile (default is 0, which means the one of the tuning
+     * profile).
+     * \throw std::invalid_argument if the matrix only holds a band of the triangle.
+     */
+    void set_upper_diagonals_dataflow(const long maxnw = 0, long tile_size = 0) const {
+        require_whole_triangle();
+        if (tile_size <= 0) tile_size = tuning.tile_size;
+        const long nw = worker_count(maxnw);
+        const long tiles = (size + tile_size - 1) / tile_size;
+
+        std::vector<std::unique_ptr<ff::ff_node>> workers;
+        for (long w = 0; w < nw; ++w) {
+            workers.push_back(std::make_unique<TileWorker>(*this, tile_size));
+        }
+
+        TileScheduler scheduler{*this, tile_size, tiles};
+        ff::ff_Farm<Tile> farm{std::move(workers)};
+        farm.add_emitter(scheduler);
+        farm.remove_collector();
+        farm.wrap_around();
+        farm.set_scheduling_ondemand();
+
+        if (farm.run_and_wait_end() < 0) {
+            throw std::runtime_error("Could not run the FastFlow farm");
+        }
+        mark_computed();
+    }
+
+private:
+
+    const NumaPolicy numa_policy; ///< The placement of the rows on the NUMA nodes.
+    const long numa_workers; ///< The number of workers that own the rows with a NUMA policy.
+    mutable ScheduleLog schedule_log; ///< The schedules chosen by the last sweep.
+
+    /**
+     * \brief Get the number of workers of a sweep.
+     * \param maxnw The number of workers asked for, 0 for the one of the tuning profile.
+     * \return The number of workers, all the cores if neither is set.
+     */
+    [[nodiscard]] long worker_count(const long maxnw) const {
+        if (maxnw > 0) return maxnw;
+        return tuning.workers > 0 ? tuning.workers : static_cast<long>(ff::ff_realNumCores());
+    }
+
+    /**
+     * \brief Pin the calling thread to the core of a worker, unless it is already there.
+     * \param worker The index of the worker.
+     */
+    static void pin(const long worker) {
+        thread_local int pinned_core = -1;
+        const int core = NumaTopology::get().core(worker);
+        if (core != pinned_core) {
+            ff::ff_mapThreadToCpu(core);
+            pinned_core = core;
+        }
+    }
+
+    /**
+     * \brief Run a body in parallel on the blocks of rows owned by each worker, on the core of the worker.
+     * The rows are dealt to the workers in blocks of cbrt_batch_size in round-robin order.
+     * \param pf The parallel for of the workers.
+     * \param rows The number of rows.
+     * \param body The body, called with the worker, the first row and the row past the last one of each block.
+     */
+    template <typename Body>
+    void for_each_owned_block(ff::ParallelFor& pf, const long rows, const Body& body) const {
+        pf.parallel_for_static(0, numa_workers, 1, 0, [&](const long worker) {
+            pin(worker);
+            for (long first = worker * cbrt_batch_size; first < rows; first += numa_workers * cbrt_batch_size) {
+                body(worker, first, std::min(first + cbrt_batch_size, rows));
+            }
+        });
+    }
+
+    /**
+     * \brief Compute some chunks of rows of a diagonal, with whole reductions, dynamically scheduled since their
+     * ranges are uneven, or on the calling thread when their work is small (see schedule_diagonal()).
+     * \param pf The parallel for of the workers.
+     * \param nw The number of workers.
+     * \param k The diagonal.
+     * \param chunks The chunks, as pairs of first row and row past the last one.
+     * \param cbrt_mode The accuracy of the cubic roots.
+     */
+    void compute_chunks(ff::ParallelFor& pf, const long nw, const long k,
+                        const std::vector<std::pair<long, long>>& chunks, const CbrtMode cbrt_mode) const {
+        long rows = 0;
+        for (const auto& [first, last] : chunks) {
+            rows += last - first;
+        }
+
+        const auto chunk_body = [&](const long c) {
+            compute_diagonal_chunk(k, chunks[c].first, chunks[c].second, cbrt_mode);
+        };
+        const DiagonalSchedule schedule = schedule_diagonal(rows, k, nw, tuning.chunk);
+        if (schedule.chunking == Chunking::Sequential) {
+            for (std::size_t c = 0; c < chunks.size(); ++c) {
+                chunk_body(static_cast<long>(c));
+            }
+        } else {
+            pf.parallel_for(0, static_cast<long>(chunks.size()), 1, 1, chunk_body, schedule.workers);
+        }
+    }
+
+    /**
+     * \brief Run a body on the rows of a diagonal, in chunks of rows scheduled as given.
+     * Without a NUMA policy, the chunks are computed on the calling thread or split among the workers by FastFlow,
+     * otherwise each worker computes the blocks of rows it owns, chunk by chunk.
+     * \param pf The parallel for of the workers.
+     * \param rows The number of rows.
+     * \param schedule The schedule of the rows.
+     * \param body The body, called with the first row and the row past the last one of each chunk.
+     */
+    template <typename Body>
+    void parallel_for_rows(ff::ParallelFor& pf, const long rows, const DiagonalSchedule& schedule,
+                           const Body& body) const {
+        const long chunk = schedule.chunk;
+        const auto chunk_body = [&](const long first) {
+            body(first, std::min(first + chunk, rows));
+        };
+
+        if (numa_policy != NumaPolicy::Default) {
+            for_each_owned_block(pf, rows, [&](const long, const long first, const long last) {
+                for (long i = first; i < last; i += chunk) {
+                    body(i, std::min(i + chunk, last));
                 }
-                // fourth element of the row and column
-                if (i + 1 + k and i + 5 < size - k) {
-                    _mm_prefetch(&data[index(i + 1, i + 5)], _MM_HINT_T2);
-                    _mm_prefetch(&data_t[index(i + 1 + k, i + 4)], _MM_HINT_T2);
+            });
+        } else if (schedule.chunking == Chunking::Sequential) {
+            for (long first = 0; first < rows; first += chunk) {
+                chunk_body(first);
+            }
+        } else if (schedule.chunking == Chunking::Dynamic) {
+            pf.parallel_for(0, rows, chunk, 1, chunk_body, schedule.workers);
+        } else {
+            pf.parallel_for_static(0, rows, chunk, 0, chunk_body, schedule.workers);
+        }
+    }
+
+    /**
+     * \brief A tile of the upper triangle.
+     */
+    struct Tile {
+        long row; ///< The row of the tile.
+        long column; ///< The column of the tile.
+    };
+
+    /**
+     * \brief The emitter of the dataflow farm.
+     * It sends the ready tiles to the workers and receives back the completed ones, counting down the dependencies
+     * of their right and upper neighbours.
+     */
+    class TileScheduler final : public ff::ff_monode_t<Tile> {
+
+    public:
+
+        /**
+         * \brief Constructor.
+         * \param matrix The matrix to compute.
+         * \param tile_size The number of rows and columns of a tile.
+         * \param tiles The number of rows and columns of tiles.
+         */
+        TileScheduler(const FFMatrix& matrix, const long tile_size, const long tiles) :
+        matrix{matrix},
+        tile_size{tile_size},
+        tiles{tiles},
+        remaining{tiles * (tiles + 1) / 2},
+        grid(tiles * tiles),
+        dependencies(tiles * tiles, 2)
+        {
+            for (long row = 0; row < tiles; ++row) {
+                for (long column = row; column < tiles; ++column) {
+                    grid[row * tiles + column] = Tile{row, column};
                 }
+            }
+        }
 
-                // Use AVX to speed up the dot product calculation
-                long j = 0;
-                __m256d sum = _mm256_setzero_pd();
-                for (; j <= k - 4; j += 4) {
-                    const __m256d row = _mm256_loadu_pd(&data[index(i, i + j)]);
-                    const __m256d column = _mm256_loadu_pd(&data_t[index(i + k, i + 1 + j)]);
-                    sum = _mm256_add_pd(sum, _mm256_mul_pd(row, column));
+        /**
+         * \brief Send the diagonal tiles at start-up, then release the neighbours of each completed tile.
+         * \param tile The completed tile (nullptr at start-up).
+         * \return GO_ON while there are tiles left, EOS when all the tiles are completed.
+         */
+        Tile* svc(Tile* tile) override {
+            if (tile == nullptr) {
+                // The diagonal tiles only depend on themselves
+                for (long t = 0; t < tiles; ++t) {
+                    this->ff_send_out(&grid[t * tiles + t]);
                 }
+                return this->GO_ON;
+            }
 
-                // Sum the elements of the AVX register
-                alignas(32) double dot_product[4];
-                _mm256_store_pd(dot_product, sum);
-                dot_product[0] += dot_product[1] + dot_product[2] + dot_product[3];
+            // The top tile of a column completes it
+            if (tile->row == 0) matrix.tile_column_done(tile->column, tile_size);
 
-                // Handle remaining elements
-                for (; j < k; ++j) {
-                    dot_product[0] += data[index(i, i + j)] * data_t[index(i + k, i + 1 + j) ];
-                }
+            if (--remaining == 0) return this->EOS;
 
-                // Store the result in the current diagonal
-                const double value = std::cbrt(dot_product[0]);
-                data[index(i, i + k)] = value;
-                data_t[index(i + k, i)] = value;
+            if (tile->column + 1 < tiles) release(tile->row, tile->column + 1);
+            if (tile->row > 0) release(tile->row - 1, tile->column);
 
-            });
+            return this->GO_ON;
+        }
+
+    private:
 
+        const FFMatrix& matrix; ///< The matrix to compute.
+        const long tile_size; ///< The number of rows and columns of a tile.
+        const long tiles; ///< The number of rows and columns of tiles.
+        long remaining; ///< The number of tiles not yet completed.
+        std::vector<Tile> grid; ///< The tiles, indexed by row * tiles + column.
+        std::vector<int> dependencies; ///< The number of uncompleted dependencies of each tile.
+
+        /**
+         * \brief Mark one dependency of a tile as completed, sending it out if it is ready.
+         * \param row The row of the tile.
+         * \param column The column of the tile.
+         */
+        void release(const long row, const long column) {
+            if (--dependencies[row * tiles + column] == 0) {
+                this->ff_send_out(&grid[row * tiles + column]);
+            }
         }
-    }
+    };
+
+    /**
+     * \brief A worker of the dataflow farm, computing the tiles it receives.
+     */
+    class TileWorker final : public ff::ff_node_t<Tile> {
+
+    public:
+
+        /**
+         * \brief Constructor.
+         * \param matrix The matrix to compute.
+         * \param tile_size The number of rows and columns of a tile.
+         */
+        TileWorker(const FFMatrix& matrix, const long tile_size) :
+        matrix{matrix},
+        tile_size{tile_size},
+        partial_sums(tile_size * tile_size)
+        {}
+
+        /**
+         * \brief Compute a tile and send it back to the scheduler.
+         * \param tile The tile to compute.
+         * \return The completed tile.
+         */
+        Tile* svc(Tile* tile) override {
+            matrix.compute_tile(tile->row, tile->column, tile_size, partial_sums.data());
+            return tile;
+        }
+
+    private:
+
+        const FFMatrix& matrix; ///< The matrix to compute.
+        const long tile_size; ///< The number of rows and columns of a tile.
+        std::vector<double> partial_sums; ///< Scratch buffer for the partial sums of a tile.
+    };
 };
 
 #endif //SPM_FFMATRIX_H
\ No newline at end of file
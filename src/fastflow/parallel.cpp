@@ -2,18 +2,123 @@
 #include <indicators/progress_bar.hpp>
 
 #include "../utils/timer.h"
-#include "../utils/csv.h"
+#include "../utils/benchmark.h"
+#include "../utils/checks.h"
 
 #include "parallel.h"
 #include "ffmatrix.h"
+#include "../sequential/seqmatrix.h"
 
+/**
+ * \brief Set the upper diagonals of a matrix in parallel, measuring the execution time.
+ * \param matrix The matrix.
+ * \param maxnw The maximum number of workers.
+ * \param tile_size The number of rows and columns of a tile (0 means no tiling).
+ * \param executor The executor of the tiles.
+ * \return The execution time.
+ */
+template <typename T>
+static double compute(const FFMatrix<T>& matrix, const long maxnw, const long tile_size, const Executor executor) {
+    return measureExecutionTime([&matrix, maxnw, tile_size, executor]() {
+        if (tile_size > 0 && executor == Executor::Dataflow)
+            matrix.set_upper_diagonals_dataflow(maxnw, tile_size);
+        else if (tile_size > 0)
+            matrix.set_upper_diagonals_tiled(maxnw, tile_size);
+        else
+            matrix.set_upper_diagonals(maxnw);
+    });
+}
+
+/**
+ * \brief Write the schedules chosen by the last sweep of a matrix as <name>_schedule_<dimension>.csv in the results
+ * directory, unless the matrix was computed tile by tile.
+ * \param log The log of the schedules.
+ * \param name The name of the benchmark.
+ * \param dimension The size of the matrix.
+ */
+static void write_schedule(const ScheduleLog& log, const std::string& name, const long dimension) {
+    if (log.empty()) return;
+
+    log.write(name + "_schedule_" + std::to_string(dimension) + ".csv");
+}
+
+/**
+ * \brief Check the stream of the diagonals of a new matrix swept in parallel (see check_stream()).
+ * \param dimension The size of the matrix.
+ * \param maxnw The maximum number of workers.
+ * \param numa_policy The placement of the storage of the matrix.
+ * \param diagonals The number of upper diagonals of the matrix (0 means all of them).
+ * \return true if the stream matches the matrix, false otherwise.
+ */
+template <typename T>
+static bool check_stream(const long dimension, const long maxnw, const NumaPolicy numa_policy, const long diagonals) {
+    FFMatrix<T> matrix{dimension, numa_policy, maxnw, diagonals};
+    return check_stream(matrix, [&matrix, maxnw]() { matrix.set_upper_diagonals(maxnw); });
+}
+
+/**
+ * \brief Check the parallel updates of the main diagonal of a new matrix (see check_update()).
+ * \param dimension The size of the matrix.
+ * \param maxnw The maximum number of workers.
+ * \param diagonals The number of upper diagonals of the matrix (0 means all of them).
+ * \param precision The precision of the matrix.
+ * \return true if the updated matrix matches a new one, false otherwise.
+ */
+template <typename T>
+static bool check_update(const long dimension, const long maxnw, const long diagonals, const Precision precision) {
+    return check_update<FFMatrix<T>>(
+            dimension, diagonals, precision, [maxnw](const FFMatrix<T>& matrix) { matrix.set_upper_diagonals(maxnw); },
+            [maxnw](const FFMatrix<T>& matrix, const auto& update) { matrix.update_main_diagonal(update, maxnw); });
+}
 
-void test_parallel(const long maxnw) {
-    constexpr int dimensions[4]{1024, 2048, 4096, 8192};
-    std::vector<std::vector<double>> results;
-    const std::vector<std::string> headers{"Dimension", "Execution Time"};
+/**
+ * \brief Check the parallel lazy evaluations of the elements of a new matrix (see check_evaluate()).
+ * \param dimension The size of the matrix.
+ * \param maxnw The maximum number of workers.
+ * \param diagonals The number of upper diagonals of the matrix (0 means all of them).
+ * \param precision The precision of the matrix.
+ * \return true if the evaluated elements match a swept matrix, false otherwise.
+ */
+template <typename T>
+static bool check_evaluate(const long dimension, const long maxnw, const long diagonals, const Precision precision) {
+    return check_evaluate<FFMatrix<T>>(
+            dimension, diagonals, precision, [maxnw](const FFMatrix<T>& matrix) { matrix.set_upper_diagonals(maxnw); },
+            [maxnw](const FFMatrix<T>& matrix, const long row, const long column) {
+                return matrix.evaluate(row, column, maxnw);
+            });
+}
 
-    std::cout << "Processing in parallel with " << maxnw << " threads..." << std::endl;
+bool test_parallel(const long maxnw, const long tile_size, const Executor executor, const Precision precision,
+                   const NumaPolicy numa_policy, const BenchmarkOptions& options) {
+    const std::string tiling = executor == Executor::Dataflow ? "_dataflow_" : "_tiled_";
+    const std::string name = "parallel_" + std::to_string(maxnw) +
+                             (tile_size > 0 ? tiling + std::to_string(tile_size) : "") +
+                             (precision == Precision::Float ? "_float" : "") +
+                             (numa_policy != NumaPolicy::Default ? "_" + to_string(numa_policy) : "") +
+                             band_suffix(options);
+    BenchmarkReport report{name, "fastflow", maxnw <= 0 ? ff::ff_realNumCores() : maxnw, options,
+                           {{"Tile Size", std::to_string(tile_size)},
+                            {"Executor", executor == Executor::Dataflow ? "dataflow" : "wavefront"},
+                            {"Precision", to_string(precision)}, {"NUMA Policy", to_string(numa_policy)}}};
+    bool valid = true;
+
+    if (tile_size > 0 && options.diagonals > 0) {
+        std::cerr << "Invalid argument: the tiles compute the whole upper triangle, not a band." << std::endl;
+        return false;
+    }
+
+    if (tile_size > 0)
+        std::cout << "Processing in parallel in " << to_string(precision) << " with " << maxnw << " threads and "
+                  << tile_size << "x" << tile_size << (executor == Executor::Dataflow ? " dataflow" : "")
+                  << " tiles..." << std::endl;
+    else
+        std::cout << "Processing in parallel in " << to_string(precision) << " with " << maxnw << " threads..."
+                  << std::endl;
+
+    // The cell of the recurrence is checked once, on a known instance (the tiles only split sums of products)
+    const bool chained = !options.check || check_chain_product<FFMatrix<double, ChainProduct>>(
+            [maxnw](const FFMatrix<double, ChainProduct>& matrix) { matrix.set_upper_diagonals(maxnw); });
+    valid = chained;
 
     indicators::ProgressBar bar {
             indicators::option::BarWidth{50},
@@ -26,19 +131,76 @@ void test_parallel(const long maxnw) {
             indicators::option::ForegroundColor{indicators::Color::yellow},
             indicators::option::ShowElapsedTime{true},
             indicators::option::ShowRemainingTime{true},
-            indicators::option::MaxProgress{4}
+            indicators::option::MaxProgress{options.dimensions.size()}
     };
 
-    for (const int dimension : dimensions) {
+    for (const long dimension : options.dimensions) {
         bar.set_option(indicators::option::PostfixText{"Processed dimension " + std::to_string(dimension)});
-        FFMatrix matrix{dimension};
-        const double executionTime = measureExecutionTime([&matrix, maxnw]() {
-            matrix.set_upper_diagonals(maxnw);
-        });
-        results.emplace_back(std::vector{static_cast<double>(dimension), executionTime});
+        std::vector<BenchmarkReport::Field> fields;
+        std::vector<double> times;
+        double checksum;
+        bool saved = true;
+
+        const FFMatrix matrix{dimension, numa_policy, maxnw, options.diagonals};
+        if (precision == Precision::Float) {
+            const FFMatrix<float> float_matrix{dimension, numa_policy, maxnw, options.diagonals};
+            times = repeat(options, [&]() { return compute(float_matrix, maxnw, tile_size, executor); });
+            checksum = float_matrix.checksum();
+            write_trace(float_matrix.get_instrumentation(), name, dimension);
+            write_schedule(float_matrix.get_schedule_log(), name, dimension);
+            if (options.save) saved = check_save(float_matrix, name, dimension);
+
+            // The double matrix is the reference for the accuracy of the float one
+            compute(matrix, maxnw, tile_size, executor);
+            fields.emplace_back("Max Relative Error", toCSVScientificField(float_matrix.max_relative_error(matrix)));
+        } else {
+            times = repeat(options, [&]() { return compute(matrix, maxnw, tile_size, executor); });
+            checksum = matrix.checksum();
+            write_trace(matrix.get_instrumentation(), name, dimension);
+            write_schedule(matrix.get_schedule_log(), name, dimension);
+            if (options.save) saved = check_save(matrix, name, dimension);
+        }
+
+        if (options.check) {
+            // The reference has the same band
+            const SeqMatrix reference{dimension, {}, {}, options.diagonals};
+            reference.set_upper_diagonals();
+            const bool matches = check_checksum(dimension, checksum, reference.checksum(), precision);
+            fields.emplace_back("Checksum Check", matches ? "ok" : "mismatch");
+            fields.emplace_back("Chain Product Check", chained ? "ok" : "mismatch");
+            valid = valid && matches;
+
+            const bool updated = precision == Precision::Float
+                                 ? check_update<float>(dimension, maxnw, options.diagonals, precision)
+                                 : check_update<double>(dimension, maxnw, options.diagonals, precision);
+            fields.emplace_back("Update Check", updated ? "ok" : "mismatch");
+            valid = valid && updated;
+
+            const bool evaluated = precision == Precision::Float
+                                   ? check_evaluate<float>(dimension, maxnw, options.diagonals, precision)
+                                   : check_evaluate<double>(dimension, maxnw, options.diagonals, precision);
+            fields.emplace_back("Evaluate Check", evaluated ? "ok" : "mismatch");
+            valid = valid && evaluated;
+
+            // Only the sweeps by diagonals stream
+            if (tile_size <= 0) {
+                const bool streamed = precision == Precision::Float
+                                      ? check_stream<float>(dimension, maxnw, numa_policy, options.diagonals)
+                                      : check_stream<double>(dimension, maxnw, numa_policy, options.diagonals);
+                fields.emplace_back("Stream Check", streamed ? "ok" : "mismatch");
+                valid = valid && streamed;
+            }
+        }
+
+        if (options.save) {
+            fields.emplace_back("Save Check", saved ? "ok" : "mismatch");
+            valid = valid && saved;
+        }
+
+        report.add(dimension, times, checksum, std::move(fields));
         bar.tick();
     }
 
-    writeCSV<double>("parallel_" + std::to_string(maxnw) + ".csv", headers, results);
-
+    report.write();
+    return valid;
 }
\ No newline at end of file
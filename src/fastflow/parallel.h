@@ -1,6 +1,17 @@
 #ifndef SPM_PARALLEL_H
 #define SPM_PARALLEL_H
 
-void test_parallel(long);
+#include "../utils/benchmark.h"
+#include "../utils/numa.h"
+
+/**
+ * \brief The executor used to compute the upper diagonals.
+ */
+enum class Executor {
+    Wavefront, ///< Diagonals (of elements or tiles) one after the other, with a barrier between them.
+    Dataflow ///< Tiles scheduled as soon as their dependencies are completed.
+};
+
+bool test_parallel(long, long, Executor, Precision, NumaPolicy, const BenchmarkOptions&);
 
 #endif //SPM_PARALLEL_H
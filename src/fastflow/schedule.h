@@ -0,0 +1,153 @@
+#ifndef SPM_SCHEDULE_H
+#define SPM_SCHEDULE_H
+
+#include <algorithm>
+#include <bit>
+#include <string>
+#include <vector>
+
+#include "../utils/cbrt.h"
+#include "../utils/csv.h"
+
+/**
+ * \brief How the rows of a diagonal are split among the workers.
+ */
+enum class Chunking {
+    Sequential, ///< All the rows on the calling thread, without dispatching to the workers.
+    Static, ///< Contiguous chunks of rows assigned to the workers before starting.
+    Dynamic ///< Chunks of rows taken by the workers as soon as they are idle.
+};
+
+/**
+ * \brief Get the name of a chunking.
+ * \param chunking The chunking.
+ * \return The name of the chunking.
+ */
+inline std::string to_string(const Chunking chunking) {
+    switch (chunking) {
+        case Chunking::Sequential: return "sequential";
+        case Chunking::Dynamic: return "dynamic";
+        default: return "static";
+    }
+}
+
+/**
+ * \brief The schedule of a parallel loop over the rows of a diagonal.
+ */
+struct DiagonalSchedule {
+    long workers; ///< The number of workers (1 when sequential).
+    Chunking chunking; ///< How the rows are split among the workers.
+    long chunk; ///< The number of rows of a chunk, at most cbrt_batch_size.
+
+    bool operator==(const DiagonalSchedule&) const = default;
+};
+
+constexpr long sequential_work = 1L << 15; ///< The work under which a diagonal is computed on the calling thread.
+constexpr long worker_work = 1L << 14; ///< The least work worth waking up one more worker for.
+constexpr long dynamic_length = 2048; ///< The dot product length from which the rows are chunked dynamically.
+constexpr long cbrt_work = 32; ///< The work of a cubic root, in multiply-adds.
+
+/**
+ * \brief Choose the schedule of a loop over the rows of a diagonal from its estimated work, rows * (length + cbrt).
+ * The cheap diagonals are computed sequentially and the others by only as many workers as they keep busy.
+ * The short dot products take the same time on all the rows, so their rows are split statically in as few chunks
+ * as possible; the long ones stream their columns from memory and their time varies with the contention, so their
+ * rows are split in smaller chunks taken dynamically, about four per worker (rounded down to a power of two).
+ * \param rows The number of rows of the diagonal.
+ * \param length The length of the dot product of each row.
+ * \param nw The number of workers available.
+ * \param max_chunk The largest number of rows of a chunk (at most cbrt_batch_size).
+ * \return The schedule.
+ */
+inline DiagonalSchedule schedule_diagonal(const long rows, const long length, const long nw,
+                                          const long max_chunk = cbrt_batch_size) {
+    const long work = rows * (length + cbrt_work);
+    if (work < sequential_work || nw <= 1 || rows <= 1) {
+        return {1, Chunking::Sequential, max_chunk};
+    }
+
+    const long workers = std::clamp(work / worker_work, 1L, std::min(nw, rows));
+    if (workers == 1) {
+        return {1, Chunking::Sequential, max_chunk};
+    }
+    if (length >= dynamic_length && rows >= 4 * workers) {
+        const auto chunk = static_cast<unsigned long>(std::clamp(rows / (4 * workers), 1L, max_chunk));
+        return {workers, Chunking::Dynamic, static_cast<long>(std::bit_floor(chunk))};
+    }
+    return {workers, Chunking::Static, std::clamp((rows + workers - 1) / workers, 1L, max_chunk)};
+}
+
+/**
+ * \brief The log of the schedules chosen for the diagonals of a sweep.
+ * The consecutive diagonals with the same schedule are merged into one range, so the log stays short.
+ */
+class ScheduleLog {
+
+public:
+
+    /**
+     * \brief Start a new sweep, discarding the schedules of the previous one.
+     */
+    void clear() {
+        ranges.clear();
+    }
+
+    /**
+     * \brief Record the schedule of a loop over the rows of a diagonal.
+     * \param k The diagonal.
+     * \param strips Whether the loop computes the partial sums of a band (see Matrix::compute_strip()).
+     * \param schedule The schedule of the loop.
+     */
+    void record(const long k, const bool strips, const DiagonalSchedule& schedule) {
+        for (auto range = ranges.rbegin(); range != ranges.rend(); ++range) {
+            if (range->strips != strips) continue;
+            if (range->schedule == schedule) {
+                range->last = k;
+                return;
+            }
+            break;
+        }
+        ranges.push_back(Range{k, k, strips, schedule});
+    }
+
+    /**
+     * \brief Check whether no schedule was recorded.
+     * \return true if the log is empty, false otherwise.
+     */
+    [[nodiscard]] bool empty() const {
+        return ranges.empty();
+    }
+
+    /**
+     * \brief Write the log as a CSV file in the results directory, one row per range of diagonals.
+     * \param filename The name of the file.
+     */
+    void write(const std::string& filename) const {
+        const std::vector<std::string> headers{"First Diagonal", "Last Diagonal", "Loop", "Workers", "Chunking",
+                                               "Chunk"};
+        std::vector<std::vector<std::string>> rows;
+        for (const Range& range : ranges) {
+            rows.push_back({std::to_string(range.first), std::to_string(range.last),
+                            range.strips ? "strips" : "elements", std::to_string(range.schedule.workers),
+                            to_string(range.schedule.chunking), std::to_string(range.schedule.chunk)});
+        }
+        writeCSV<std::string>(filename, headers, rows);
+    }
+
+private:
+
+    /**
+     * \brief A range of diagonals with the same schedule.
+     */
+    struct Range {
+        long first; ///< The first diagonal of the range.
+        long last; ///< The last diagonal of the range.
+        bool strips; ///< Whether the loops compute the partial sums of the bands.
+        DiagonalSchedule schedule; ///< The schedule of the loops.
+    };
+
+    std::vector<Range> ranges; ///< The ranges of diagonals, in order.
+
+};
+
+#endif //SPM_SCHEDULE_H
\ No newline at end of file
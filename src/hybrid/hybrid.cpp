@@ -0,0 +1,118 @@
+#include <vector>
+#include <indicators/progress_bar.hpp>
+
+#include "hybridmatrix.h"
+#include "../utils/timer.h"
+#include "../utils/benchmark.h"
+#include "../utils/checks.h"
+#include "../sequential/seqmatrix.h"
+
+#include "hybrid.h"
+
+/**
+ * \brief Set the upper diagonals of a matrix on all the processes, measuring the execution time.
+ * The processes start together, and the execution time is the mean of the ones of the processes.
+ * \param matrix The matrix.
+ * \param mpi_world_size The number of MPI processes.
+ * \return The execution time.
+ */
+template <typename T>
+static double compute(const MPIMatrix<T>& matrix, const int mpi_world_size) {
+    MPI_Barrier(MPI_COMM_WORLD);
+    const double execution_time = measureExecutionTime([&matrix]() {
+        matrix.set_upper_diagonals();
+    });
+
+    double total_execution_time;
+    MPI_Allreduce(&execution_time, &total_execution_time, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    return total_execution_time / mpi_world_size;
+}
+
+bool test_hybrid(const int rank, const int mpi_world_size, const long maxnw, const Partitioning partitioning,
+                 const int cyclic_block, const Precision precision, const BenchmarkOptions& options) {
+    const long nw = maxnw <= 0 ? ff::ff_realNumCores() : maxnw;
+    const std::string name = "hybrid_" + std::to_string(mpi_world_size) + "x" + std::to_string(maxnw) +
+                             (precision == Precision::Float ? "_float" : "") + band_suffix(options);
+    BenchmarkReport report{name, "hybrid", mpi_world_size * nw, options,
+                           {{"Processes", std::to_string(mpi_world_size)}, {"Workers", std::to_string(nw)},
+                            {"Partitioning", to_string(partitioning)}, {"Cyclic Block", std::to_string(cyclic_block)},
+                            {"Precision", to_string(precision)}}};
+    int valid = 1;
+
+    if (rank == 0)
+        std::cout << "Processing hybrid in " << to_string(precision) << " with " << mpi_world_size << " processes of "
+                  << maxnw << " threads and " << to_string(partitioning) << " partitioning..." << std::endl;
+
+    indicators::ProgressBar bar {
+        indicators::option::BarWidth{50},
+        indicators::option::Start{"["},
+        indicators::option::Fill{"="},
+        indicators::option::Lead{">"},
+        indicators::option::Remainder{" "},
+        indicators::option::End{"]"},
+        indicators::option::PostfixText{"Initializing..."},
+        indicators::option::ForegroundColor{indicators::Color::yellow},
+        indicators::option::ShowElapsedTime{true},
+        indicators::option::ShowRemainingTime{true},
+        indicators::option::MaxProgress{options.dimensions.size()}
+    };
+
+    for (const long dimension : options.dimensions) {
+        if (rank == 0)
+            bar.set_option(indicators::option::PostfixText{"Processed dimension " + std::to_string(dimension)});
+        std::vector<BenchmarkReport::Field> fields{{"Partitioning", to_string(partitioning)}};
+        std::vector<double> times;
+        double checksum;
+        bool saved = true;
+
+        const int size = static_cast<int>(dimension);
+        const int diagonals = static_cast<int>(std::min(options.diagonals, dimension));
+        const HybridMatrix matrix{size, rank, mpi_world_size, maxnw, partitioning, cyclic_block, true, {}, {},
+                                  diagonals};
+        if (precision == Precision::Float) {
+            const HybridMatrix<float> float_matrix{size, rank, mpi_world_size, maxnw, partitioning, cyclic_block,
+                                                   true, {}, {}, diagonals};
+            times = repeat(options, [&]() { return compute(float_matrix, mpi_world_size); });
+            checksum = float_matrix.checksum();
+            write_trace(float_matrix.get_instrumentation(), name, dimension, "_rank" + std::to_string(rank));
+            if (options.save) saved = check_save(float_matrix, name, dimension, rank == 0);
+
+            // The double matrix is the reference for the accuracy of the float one (compared on all the processes,
+            // which hold only their rows with the distributed partitioning)
+            compute(matrix, mpi_world_size);
+            const double error = float_matrix.max_relative_error(matrix);
+            if (rank == 0)
+                fields.emplace_back("Max Relative Error", toCSVScientificField(error));
+        } else {
+            times = repeat(options, [&]() { return compute(matrix, mpi_world_size); });
+            checksum = matrix.checksum();
+            write_trace(matrix.get_instrumentation(), name, dimension, "_rank" + std::to_string(rank));
+            if (options.save) saved = check_save(matrix, name, dimension, rank == 0);
+        }
+
+        if (rank == 0) {
+            if (options.check) {
+                // The reference has the same band
+                const SeqMatrix reference{dimension, {}, {}, options.diagonals};
+                reference.set_upper_diagonals();
+                const bool matches = check_checksum(dimension, checksum, reference.checksum(), precision);
+                fields.emplace_back("Checksum Check", matches ? "ok" : "mismatch");
+                valid = valid && matches;
+            }
+            if (options.save) {
+                fields.emplace_back("Save Check", saved ? "ok" : "mismatch");
+                valid = valid && saved;
+            }
+            report.add(dimension, times, checksum, std::move(fields));
+            bar.tick();
+        }
+    }
+
+    if (rank == 0) {
+        report.write();
+    }
+
+    // All the processes exit with the result of the checks
+    MPI_Bcast(&valid, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    return valid;
+}
\ No newline at end of file
@@ -0,0 +1,9 @@
+#ifndef SPM_HYBRID_H
+#define SPM_HYBRID_H
+
+#include "../mpi/mpimatrix.h"
+#include "../utils/benchmark.h"
+
+bool test_hybrid(int, int, long, Partitioning, int, Precision, const BenchmarkOptions&);
+
+#endif //SPM_HYBRID_H
@@ -0,0 +1,93 @@
+#ifndef SPM_HYBRIDMATRIX_H
+#define SPM_HYBRIDMATRIX_H
+
+#include <ff/parallel_for.hpp>
+
+#include "../mpi/mpimatrix.h"
+
+/**
+ * \brief A class to represent an upper triangular matrix (stored in a 1D array),
+ * with the computation of the upper diagonals distributed across processes using MPI,
+ * and the rows of each process computed in parallel using FastFlow.
+ * Only the thread that calls set_upper_diagonals() makes MPI calls (MPI_THREAD_FUNNELED is enough).
+ * \tparam T The type of the stored and exchanged elements (double or float).
+ * \tparam Cell The recurrence of the upper diagonals (see Matrix).
+ */
+template <typename T = double, typename Cell = CbrtDotProduct>
+class HybridMatrix final : public MPIMatrix<T, Cell> {
+
+protected:
+
+    using MPIMatrix<T, Cell>::compute_strip;
+    using MPIMatrix<T, Cell>::compute_batch;
+
+public:
+    /**
+     * \brief Constructor.
+     * \param size The size of the matrix (the number of rows and columns).
+     * \param rank The rank of the MPI process.
+     * \param mpi_world_size The number of MPI processes.
+     * \param maxnw The maximum number of workers of each process (0 means auto-detect).
+     * \param partitioning The strategy used to assign the rows of each diagonal to the processes (default is block).
+     * \param cyclic_block The number of rows of a block for the block-cyclic partitioning (default is 1).
+     * \param register_blocking Whether to compute the diagonals in bands with the strip kernel (default is true).
+     * \param diagonal The main diagonal, size elements (default is empty, for 1/size, 2/size, ..., size/size).
+     * \param cell The cell of the recurrence (default is a default-constructed one).
+     * \param diagonals The number of upper diagonals stored and computed (default is 0, which means all of them).
+     */
+    HybridMatrix(const int size, const int rank, const int mpi_world_size, const long maxnw,
+                 const Partitioning partitioning = Partitioning::Block, const int cyclic_block = 1,
+                 const bool register_blocking = true, const std::vector<double>& diagonal = {},
+                 const Cell& cell = {}, const int diagonals = 0) :
+        MPIMatrix<T, Cell>(size, rank, mpi_world_size, partitioning, cyclic_block, register_blocking, diagonal, cell,
+                           diagonals),
+        nw{(maxnw <= 0) ? ff::ff_realNumCores() : maxnw},
+        pf{(maxnw <= 0) ? ff::ParallelFor{true, true} : ff::ParallelFor{maxnw, true, true}}
+    {}
+
+protected:
+
+    /**
+     * \brief Compute the partial sums of some rows in parallel for the band of diagonals starting at k.
+     * \param k The first diagonal of the band.
+     * \param rows The rows to compute, as pairs of position in the send buffer and row index.
+     */
+    void compute_strips(const int k, const std::vector<std::pair<int, int>>& rows) const override {
+        pf.parallel_for_static(0, static_cast<long>(rows.size()), 1, 0, [&](const long r) {
+            compute_strip(rows[r].second, k);
+        });
+    }
+
+    /**
+     * \brief Compute some rows of a diagonal in parallel, storing their elements in the matrix and in the send buffer.
+     * The exchange in flight progresses in the background or when it is waited for,
+     * since the workers do not make MPI calls.
+     * \param k The diagonal.
+     * \param rows The rows to compute, as pairs of position in the send buffer and row index.
+     * \param send_buffer The buffer of the diagonal elements computed by this process.
+     * \param cbrt_mode The accuracy of the cubic roots.
+     */
+    void compute_rows(const int k, const std::vector<std::pair<int, int>>& rows, T* const send_buffer,
+                      MPI_Request&, const CbrtMode cbrt_mode) const override {
+        // Not worth waking up the workers for the last few rows of each block
+        if (rows.size() < 2) {
+            compute_batch(k, rows, 0, rows.size(), send_buffer, cbrt_mode);
+            return;
+        }
+
+        // Batches small enough to keep all the workers busy
+        const long count = static_cast<long>(rows.size());
+        const long batch = std::clamp((count + nw - 1) / nw, 1L, cbrt_batch_size);
+        pf.parallel_for_static(0, count, batch, 0, [&](const long first) {
+            compute_batch(k, rows, first, std::min(first + batch, count), send_buffer, cbrt_mode);
+        });
+    }
+
+private:
+
+    const long nw; ///< The number of workers of each process.
+    mutable ff::ParallelFor pf; ///< The FastFlow parallel for, kept alive across the diagonals.
+
+};
+
+#endif //SPM_HYBRIDMATRIX_H
\ No newline at end of file
@@ -3,19 +3,44 @@
 
 #include "mpimatrix.h"
 #include "../utils/timer.h"
-#include "../utils/csv.h"
+#include "../utils/benchmark.h"
+#include "../utils/checks.h"
+#include "../sequential/seqmatrix.h"
 
 #include "distributed.h"
 
-#include <numeric>
+/**
+ * \brief Set the upper diagonals of a matrix on all the processes, measuring the execution time.
+ * The processes start together, and the execution time is the mean of the ones of the processes.
+ * \param matrix The matrix.
+ * \param mpi_world_size The number of MPI processes.
+ * \return The execution time.
+ */
+template <typename T>
+static double compute(const MPIMatrix<T>& matrix, const int mpi_world_size) {
+    MPI_Barrier(MPI_COMM_WORLD);
+    const double execution_time = measureExecutionTime([&matrix]() {
+        matrix.set_upper_diagonals();
+    });
 
-void test_distributed(const int rank, const int mpi_world_size) {
-    constexpr int dimensions[4]{1024, 2048, 4096, 8192};
-    std::vector<std::vector<double>> results;
-    const std::vector<std::string> headers{"Dimension", "Execution Time"};
+    double total_execution_time;
+    MPI_Allreduce(&execution_time, &total_execution_time, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+    return total_execution_time / mpi_world_size;
+}
+
+bool test_distributed(const int rank, const int mpi_world_size, const Partitioning partitioning, const int cyclic_block,
+                      const Precision precision, const BenchmarkOptions& options) {
+    const std::string name = "distributed_" + std::to_string(mpi_world_size) +
+                             (precision == Precision::Float ? "_float" : "") + band_suffix(options);
+    BenchmarkReport report{name, "mpi", mpi_world_size, options,
+                           {{"Processes", std::to_string(mpi_world_size)}, {"Partitioning", to_string(partitioning)},
+                            {"Cyclic Block", std::to_string(cyclic_block)}, {"Precision", to_string(precision)}}};
+    int valid = 1;
 
     if (rank == 0)
-        std::cout << "Processing distributed with " << mpi_world_size << " processes..." << std::endl;
+        std::cout << "Processing distributed in " << to_string(precision) << " with " << mpi_world_size
+                  << " processes and "
+                  << to_string(partitioning) << " partitioning..." << std::endl;
 
     indicators::ProgressBar bar {
         indicators::option::BarWidth{50},
@@ -28,29 +53,64 @@ void test_distributed(const int rank, const int mpi_world_size) {
         indicators::option::ForegroundColor{indicators::Color::yellow},
         indicators::option::ShowElapsedTime{true},
         indicators::option::ShowRemainingTime{true},
-        indicators::option::MaxProgress{4}
+        indicators::option::MaxProgress{options.dimensions.size()}
     };
 
-    for (const int dimension : dimensions) {
+    for (const long dimension : options.dimensions) {
         if (rank == 0)
             bar.set_option(indicators::option::PostfixText{"Processed dimension " + std::to_string(dimension)});
-        MPIMatrix matrix{dimension, rank, mpi_world_size};
-        const double executionTime = measureExecutionTime([&matrix]() {
-             matrix.set_upper_diagonals();
-        });
-
-        // Gather execution times from all processes
-        std::vector<double> all_execution_times(mpi_world_size);
-        MPI_Gather(&executionTime, 1, MPI_DOUBLE, all_execution_times.data(), 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+        std::vector<BenchmarkReport::Field> fields{{"Partitioning", to_string(partitioning)}};
+        std::vector<double> times;
+        double checksum;
+        bool saved = true;
+
+        const int size = static_cast<int>(dimension);
+        const int diagonals = static_cast<int>(std::min(options.diagonals, dimension));
+        const MPIMatrix matrix{size, rank, mpi_world_size, partitioning, cyclic_block, true, {}, {}, diagonals};
+        if (precision == Precision::Float) {
+            const MPIMatrix<float> float_matrix{size, rank, mpi_world_size, partitioning, cyclic_block, true, {}, {},
+                                                diagonals};
+            times = repeat(options, [&]() { return compute(float_matrix, mpi_world_size); });
+            checksum = float_matrix.checksum();
+            write_trace(float_matrix.get_instrumentation(), name, dimension, "_rank" + std::to_string(rank));
+            if (options.save) saved = check_save(float_matrix, name, dimension, rank == 0);
+
+            // The double matrix is the reference for the accuracy of the float one (compared on all the processes,
+            // which hold only their rows with the distributed partitioning)
+            compute(matrix, mpi_world_size);
+            const double error = float_matrix.max_relative_error(matrix);
+            if (rank == 0)
+                fields.emplace_back("Max Relative Error", toCSVScientificField(error));
+        } else {
+            times = repeat(options, [&]() { return compute(matrix, mpi_world_size); });
+            checksum = matrix.checksum();
+            write_trace(matrix.get_instrumentation(), name, dimension, "_rank" + std::to_string(rank));
+            if (options.save) saved = check_save(matrix, name, dimension, rank == 0);
+        }
+
         if (rank == 0) {
-            const double total_execution_time = std::accumulate(all_execution_times.begin(), all_execution_times.end(), 0.0);
-            results.emplace_back(std::vector{static_cast<double>(dimension), total_execution_time / mpi_world_size});
+            if (options.check) {
+                // The reference has the same band
+                const SeqMatrix reference{dimension, {}, {}, options.diagonals};
+                reference.set_upper_diagonals();
+                const bool matches = check_checksum(dimension, checksum, reference.checksum(), precision);
+                fields.emplace_back("Checksum Check", matches ? "ok" : "mismatch");
+                valid = valid && matches;
+            }
+            if (options.save) {
+                fields.emplace_back("Save Check", saved ? "ok" : "mismatch");
+                valid = valid && saved;
+            }
+            report.add(dimension, times, checksum, std::move(fields));
             bar.tick();
         }
     }
 
     if (rank == 0) {
-        writeCSV<double>("distributed_" + std::to_string(mpi_world_size) + ".csv", headers, results);
+        report.write();
     }
 
+    // All the processes exit with the result of the checks
+    MPI_Bcast(&valid, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    return valid;
 }
\ No newline at end of file
@@ -1,6 +1,9 @@
 #ifndef SPM_DISTRIBUTED_H
 #define SPM_DISTRIBUTED_H
 
-void test_distributed(int, int);
+#include "mpimatrix.h"
+#include "../utils/benchmark.h"
+
+bool test_distributed(int, int, Partitioning, int, Precision, const BenchmarkOptions&);
 
 #endif //SPM_DISTRIBUTED_H
@@ -0,0 +1,93 @@
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "mpibatch.h"
+#include "../utils/timer.h"
+#include "../utils/benchmark.h"
+#include "../sequential/seqmatrix.h"
+
+#include "distributed_batch.h"
+
+/**
+ * \brief Compute a batch of matrices on all the processes, measuring the execution time.
+ * The processes start together, and the execution time is the one of the slowest process.
+ * \param batch The batch executor.
+ * \param items The matrices of the batch.
+ * \param checksums The checksums of the matrices.
+ * \return The execution time.
+ */
+template <typename T>
+static double compute(const MPIBatch<T>& batch, const std::vector<BatchItem>& items, std::vector<double>& checksums) {
+    MPI_Barrier(MPI_COMM_WORLD);
+    const double execution_time = measureExecutionTime([&]() {
+        checksums = batch.compute(items);
+    });
+
+    double max_execution_time;
+    MPI_Allreduce(&execution_time, &max_execution_time, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    return max_execution_time;
+}
+
+bool test_distributed_batch(const int rank, const int mpi_world_size, const long count, const long parallel_size,
+                            const Precision precision, const BenchmarkOptions& options) {
+    const std::string name = "distributed_batch_" + std::to_string(mpi_world_size) +
+                             (precision == Precision::Float ? "_float" : "") + band_suffix(options);
+    std::string sizes;
+    for (const long dimension : options.dimensions) {
+        sizes += (sizes.empty() ? "" : ";") + std::to_string(dimension);
+    }
+    BenchmarkReport report{name, "mpi-batch", mpi_world_size, options,
+                           {{"Processes", std::to_string(mpi_world_size)}, {"Sizes", sizes},
+                            {"Parallel Size", std::to_string(parallel_size)}, {"Precision", to_string(precision)}}};
+    int valid = 1;
+
+    if (rank == 0)
+        std::cout << "Processing a batch of " << count << " matrices in " << to_string(precision) << " with "
+                  << mpi_world_size << " processes..." << std::endl;
+
+    const std::vector<BatchItem> items = make_batch(options.dimensions, count, options.diagonals);
+    std::vector<double> checksums;
+    std::vector<double> times;
+    if (precision == Precision::Float) {
+        const MPIBatch<float> batch{rank, mpi_world_size, parallel_size};
+        times = repeat(options, [&]() { return compute(batch, items, checksums); });
+    } else {
+        const MPIBatch batch{rank, mpi_world_size, parallel_size};
+        times = repeat(options, [&]() { return compute(batch, items, checksums); });
+    }
+
+    if (rank == 0) {
+        double checksum = 0.0;
+        for (const double value : checksums) {
+            checksum += value;
+        }
+        std::vector<BenchmarkReport::Field> fields{
+                {"Matrices per Second", toCSVField(static_cast<double>(count) / summarize(times).median)}};
+
+        if (options.check) {
+            // One reference for each size of the batch
+            std::map<long, double> references;
+            double reference = 0.0;
+            for (const BatchItem& item : items) {
+                if (references.count(item.size) == 0) {
+                    const SeqMatrix matrix{item.size, {}, {}, item.diagonals};
+                    matrix.set_upper_diagonals();
+                    references[item.size] = matrix.checksum();
+                }
+                reference += references[item.size];
+            }
+            const bool matches = check_checksum(count, checksum, reference, precision);
+            fields.emplace_back("Checksum Check", matches ? "ok" : "mismatch");
+            valid = matches;
+        }
+
+        report.add_batch(count, times, checksum, std::move(fields));
+        report.write();
+    }
+
+    // All the processes exit with the result of the checks
+    MPI_Bcast(&valid, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    return valid;
+}
\ No newline at end of file
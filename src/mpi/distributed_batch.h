@@ -0,0 +1,8 @@
+#ifndef SPM_DISTRIBUTED_BATCH_H
+#define SPM_DISTRIBUTED_BATCH_H
+
+#include "../utils/benchmark.h"
+
+bool test_distributed_batch(int, int, long, long, Precision, const BenchmarkOptions&);
+
+#endif //SPM_DISTRIBUTED_BATCH_H
\ No newline at end of file
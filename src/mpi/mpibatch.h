@@ -0,0 +1,95 @@
+#ifndef SPM_MPIBATCH_H
+#define SPM_MPIBATCH_H
+
+#include <mpi.h>
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include "mpimatrix.h"
+#include "../sequential/seqmatrix.h"
+#include "../utils/batch_item.h"
+
+/**
+ * \brief A class to compute batches of independent matrices across MPI processes.
+ * The large matrices are computed one after the other, each one by all the processes (see MPIMatrix);
+ * the others are assigned to the processes before starting, the most expensive first to the least loaded process,
+ * and each process computes its matrices sequentially (see SeqMatrix) without any communication.
+ * \tparam T The type of the stored elements (double or float).
+ */
+template <typename T = double>
+class MPIBatch {
+
+public:
+
+    /**
+     * \brief Constructor.
+     * \param rank The rank of the MPI process.
+     * \param mpi_world_size The number of MPI processes.
+     * \param parallel_size The size from which a matrix is computed by all the processes (default is 4096).
+     */
+    MPIBatch(const int rank, const int mpi_world_size, const long parallel_size = 4096) :
+    rank{rank},
+    mpi_world_size{mpi_world_size},
+    parallel_size{parallel_size}
+    {}
+
+    /**
+     * \brief Compute the upper diagonals of all the matrices of a batch, on all the processes.
+     * \param items The matrices of the batch.
+     * \return The checksums of the matrices (see Matrix::checksum()), on all the processes.
+     */
+    [[nodiscard]] std::vector<double> compute(const std::vector<BatchItem>& items) const {
+        std::vector<double> checksums(items.size(), 0.0);
+        const std::vector<int> owners = assign(items);
+
+        for (const std::size_t index : batch_order(items)) {
+            const BatchItem& item = items[index];
+            if (owners[index] < 0) {
+                // The large matrices, with the rows distributed across all the processes
+                const int diagonals = static_cast<int>(std::min(item.diagonals, item.size));
+                const MPIMatrix<T> matrix{static_cast<int>(item.size), rank, mpi_world_size, Partitioning::Block, 1,
+                                          true, item.diagonal, {}, diagonals};
+                matrix.set_upper_diagonals();
+                if (rank == 0) checksums[index] = matrix.checksum();
+            } else if (owners[index] == rank) {
+                const SeqMatrix<T> matrix{item.size, item.diagonal, {}, item.diagonals};
+                matrix.set_upper_diagonals();
+                checksums[index] = matrix.checksum();
+            }
+        }
+
+        // Each checksum was computed by one process
+        if (mpi_world_size > 1) {
+            MPI_Allreduce(MPI_IN_PLACE, checksums.data(), static_cast<int>(checksums.size()), MPI_DOUBLE, MPI_SUM,
+                          MPI_COMM_WORLD);
+        }
+        return checksums;
+    }
+
+private:
+
+    const int rank; ///< The rank of this MPI process.
+    const int mpi_world_size; ///< The number of MPI processes.
+    const long parallel_size; ///< The size from which a matrix is computed by all the processes.
+
+    /**
+     * \brief Assign the matrices of a batch to the processes, the same way on all of them.
+     * \param items The matrices of the batch.
+     * \return The process of each matrix, -1 for the ones computed by all the processes.
+     */
+    [[nodiscard]] std::vector<int> assign(const std::vector<BatchItem>& items) const {
+        std::vector<int> owners(items.size(), -1);
+        std::vector<double> loads(mpi_world_size, 0.0);
+        for (const std::size_t index : batch_order(items)) {
+            if (items[index].size >= parallel_size) continue;
+            const auto least_loaded = std::min_element(loads.begin(), loads.end());
+            *least_loaded += batch_cost(items[index].size, items[index].diagonals);
+            owners[index] = static_cast<int>(least_loaded - loads.begin());
+        }
+        return owners;
+    }
+
+};
+
+#endif //SPM_MPIBATCH_H
\ No newline at end of file
@@ -1,72 +1,182 @@
 #ifndef SPM_MPIMATRIX_H
 #define SPM_MPIMATRIX_H
 
-#include <immintrin.h>
+#include <xmmintrin.h>
 #include <mpi.h>
+#include <algorithm>
 #include <cmath>
-#include <mm_malloc.h>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "../utils/cbrt.h"
+#include "../utils/cell.h"
+#include "../utils/diagonal_stream.h"
+#include "../utils/instrumentation.h"
+#include "../utils/kernels.h"
+#include "../utils/storage.h"
+#include "../utils/triangle_file.h"
+#include "../utils/tuning.h"
+
+/**
+ * \brief The strategy used to assign the rows of each diagonal to the MPI processes.
+ */
+enum class Partitioning {
+    Block, ///< Each process owns a fixed contiguous block of rows.
+    BlockCyclic, ///< Blocks of rows are dealt to the processes in round-robin order.
+    Rebalanced, ///< The rows of each diagonal (or band of diagonals) are split again in equal contiguous blocks.
+    Distributed ///< As block, with each process storing only its rows and the columns they read (see MPIMatrix).
+};
+
+/**
+ * \brief Get the name of a partitioning strategy.
+ * \param partitioning The partitioning strategy.
+ * \return The name of the partitioning strategy.
+ */
+inline std::string to_string(const Partitioning partitioning) {
+    switch (partitioning) {
+        case Partitioning::BlockCyclic: return "block-cyclic";
+        case Partitioning::Rebalanced: return "rebalanced";
+        case Partitioning::Distributed: return "distributed";
+        default: return "block";
+    }
+}
+
+/**
+ * \brief Parse a partitioning strategy: block, cyclic[:<rows per block>], rebalanced or distributed.
+ * \param name The name of the partitioning strategy.
+ * \param partitioning The parsed partitioning strategy.
+ * \param cyclic_block The parsed number of rows of a block for the block-cyclic partitioning.
+ * \return true if the name is a valid partitioning strategy, false otherwise.
+ */
+inline bool parse_partitioning(const std::string& name, Partitioning& partitioning, int& cyclic_block) {
+    cyclic_block = 1;
+    if (name == "block") {
+        partitioning = Partitioning::Block;
+    } else if (name == "rebalanced") {
+        partitioning = Partitioning::Rebalanced;
+    } else if (name == "distributed") {
+        partitioning = Partitioning::Distributed;
+    } else if (name == "cyclic") {
+        partitioning = Partitioning::BlockCyclic;
+    } else if (name.rfind("cyclic:", 0) == 0 && name.size() > 7 &&
+               name.find_first_not_of("0123456789", 7) == std::string::npos) {
+        partitioning = Partitioning::BlockCyclic;
+        try {
+            cyclic_block = std::stoi(name.substr(7));
+        } catch ([[maybe_unused]] const std::out_of_range &e) {
+            return false;
+        }
+        return cyclic_block > 0;
+    } else {
+        return false;
+    }
+    return true;
+}
 
 /**
  * \brief A class to represent an upper triangular matrix (stored in a 1D array),
  * with the computation of the upper diagonals distributed across processes using MPI.
+ * \tparam T The type of the stored and exchanged elements: double, or float to also halve the messages.
+ * The dot products and the cubic roots are always computed in double precision, the results are rounded on store.
+ * \tparam Cell The recurrence of the upper diagonals (see Matrix).
+ * As Matrix, it can hold only a band of the first upper diagonals, in O(size * K) memory on each process.
+ *
+ * With the distributed partitioning, the processes do not replicate the matrix: each one owns a block of rows and
+ * stores only them and a window of the transpose: the columns its rows read during the current diagonal, one per row.
+ * Instead of all-gathering each diagonal, a column is sent point-to-point to the previous process when it leaves the
+ * window of a process, just in time to enter the one of the previous process (see exchange_halos()), so the memory of
+ * each process is O(rows * size), O(rows * K) with a band.
  */
-class MPIMatrix final {
+template <typename T = double, typename Cell = CbrtDotProduct>
+class MPIMatrix {
 
 public:
+
+    /**
+     * \brief A consumer of the diagonals of the sweeps (see stream_diagonals()).
+     */
+    using DiagonalConsumer = typename DiagonalStream<T>::Consumer;
+
     /**
      * \brief Constructor.
      * \param size The size of the matrix (the number of rows and columns).
      * \param rank The rank of the MPI process.
      * \param mpi_world_size The number of MPI processes.
+     * \param partitioning The strategy used to assign the rows of each diagonal to the processes (default is block).
+     * \param cyclic_block The number of rows of a block for the block-cyclic partitioning (default is 1).
+     * \param register_blocking Whether to compute the diagonals in bands with the strip kernel (default is true).
+     * \param diagonal The main diagonal, size elements (default is empty, for 1/size, 2/size, ..., size/size).
+     * \param cell The cell of the recurrence (default is a default-constructed one).
+     * \param diagonals The number of upper diagonals stored and computed (default is 0, which means all of them).
+     * \throw std::invalid_argument if the diagonal has the wrong number of elements.
      */
-    MPIMatrix(const int size, const int rank, const int mpi_world_size) :
-        size{size},
+    MPIMatrix(const int size, const int rank, const int mpi_world_size,
+              const Partitioning partitioning = Partitioning::Block, const int cyclic_block = 1,
+              const bool register_blocking = true, const std::vector<double>& diagonal = {}, const Cell& cell = {},
+              const int diagonals = 0) :
+        // Check the diagonal before anything is allocated
+        size{diagonal.empty() || static_cast<int>(diagonal.size()) == size ? size :
+             throw std::invalid_argument("The main diagonal must have " + std::to_string(size) + " elements")},
+        diagonals{diagonals > 0 && diagonals < size - 1 ? diagonals : std::max(size - 1, 0)},
+        banded{this->diagonals < size - 1},
         rank{rank},
         mpi_world_size{mpi_world_size},
+        procs{std::min(size, mpi_world_size)},
+        partitioning{partitioning},
+        cyclic_block{std::max(cyclic_block, 1)},
         rows_per_proc{size / mpi_world_size},
         remainder{size % mpi_world_size},
-        start_row{rank * rows_per_proc + std::min(rank, remainder)},
-        end_row{start_row + rows_per_proc + (rank < remainder ? 1 : 0)},
-        data{end_row > start_row ? static_cast<double*>(_mm_malloc(size * (size + 1) / 2 * sizeof(double), 32)) : nullptr},
-        data_t{end_row > start_row ? static_cast<double*>(_mm_malloc(size * (size + 1) / 2 * sizeof(double), 32)) : nullptr},
-        diagonal_buffer{end_row > start_row ? new double[end_row - start_row] : nullptr},
-        combined_diagonal_buffer{end_row > start_row ? new double[size] : nullptr},
-        recvcounts(rank == 0 ? new int[mpi_world_size] : nullptr),
-        displs(rank == 0 ? new int[mpi_world_size] : nullptr)
+        distributed{partitioning == Partitioning::Distributed},
+        origin{distributed && rank < procs ? block_begin(rank) : 0},
+        rows_end{distributed && rank < procs ? block_begin(rank + 1) : size},
+        window{distributed ? rows_end - origin : size},
+        column_length{distributed ? std::min(this->diagonals + 1, size - origin) : 0},
+        first_band{register_blocking && Cell::sum_of_products && !distributed ?
+                   std::min(static_cast<int>(strip_width), this->diagonals + 1) : this->diagonals + 1},
+        tuning{TuningProfile::get().settings(size)},
+        cell{cell},
+        data_storage{rank < procs ? stored_elements(rows_end - origin) : 0},
+        data_t_storage{rank < procs ? (distributed ? static_cast<long>(window) * column_length : stored_elements(size))
+                                    : 0},
+        data{data_storage.get()},
+        data_t{data_t_storage.get()},
+        diagonal_buffer{rank < procs ? new T[2 * size] : nullptr},
+        combined_diagonal_buffer{rank < procs && !distributed ? new T[size] : nullptr},
+        recvcounts(rank < procs ? new int[procs] : nullptr),
+        displs(rank < procs ? new int[procs] : nullptr),
+        partial_sums{rank < procs && first_band <= this->diagonals ? new double[size * strip_width] : nullptr}
     {
         if (mpi_world_size != 1) {
             // Create a new communicator for processes with valid rows
-            MPI_Comm_split(MPI_COMM_WORLD, end_row > start_row, rank, &comm);
+            MPI_Comm_split(MPI_COMM_WORLD, rank < procs, rank, &comm);
         }
 
-        if (end_row <= start_row) return;
+        if (rank >= procs) return;
 
-        for (long i = 0; i < size; ++i) {
-            data[index(i, i)] = static_cast<double>(i + 1) / static_cast<double>(size);
-            data_t[index(i, i)] = static_cast<double>(i + 1) / static_cast<double>(size);
-        }
-
-        if (rank == 0) {
-            for (int i = 0; i < mpi_world_size; ++i) {
-                const int proc_rows = size / mpi_world_size + (i < remainder ? 1 : 0);
-                recvcounts[i] = proc_rows;
-            }
-            for (int i = 0; i < mpi_world_size; ++i) {
-                displs[i] = (i == 0) ? 0 : displs[i - 1] + recvcounts[i - 1];
-            }
+        for (long i = origin; i < size; ++i) {
+            const double value = diagonal.empty() ? static_cast<double>(i + 1) / static_cast<double>(size) : diagonal[i];
+            if (i < rows_end) data[index(i, i)] = static_cast<T>(value);
+            if (!distributed) data_t[transposed_index(i, i)] = static_cast<T>(value);
         }
     }
 
     /**
      * \brief Destructor to free allocated memory.
      */
-    ~MPIMatrix() {
-        if (data) _mm_free(data);
-        if (data_t) _mm_free(data_t);
+    virtual ~MPIMatrix() {
         delete[] diagonal_buffer;
         delete[] combined_diagonal_buffer;
         delete[] recvcounts;
         delete[] displs;
+        delete[] partial_sums;
         if (comm != MPI_COMM_NULL) {
             MPI_Comm_free(&comm);
         }
@@ -74,95 +184,110 @@ public:
 
     /**
      * \brief Set the upper diagonals of the matrix in parallel using MPI.
+     * Each diagonal is exchanged with a non-blocking all-gather, while the rows of the next diagonal that only depend
+     * on values already available locally are computed.
+     * With register blocking, the diagonals from strip_width on are computed in bands of strip_width diagonals:
+     * at the start of a band, each process computes the partial sums of its rows for the whole band
+     * (see SeqMatrix::set_upper_diagonals()), then the diagonals of the band are computed and exchanged one by one.
+     * The rows of a process are the same for all the diagonals of a band.
+     * With SPM_INSTRUMENT, each diagonal is traced from the start of its rows to the start of its exchange, so its
+     * communication time is the wait for the exchange of the previous diagonal (see get_instrumentation()).
+     * The batches of cubic roots and the prefetch distance are the ones of the tuning profile.
+     * With a band, the sweep stops at its last diagonal, so only the diagonals of the band are exchanged.
+     * With the distributed partitioning, the columns of the transpose are exchanged between neighbours (see
+     * exchange_halos()).
+     * \param cbrt_mode The accuracy of the cubic roots (default is exact).
      */
-    void set_upper_diagonals() const {
-        if (end_row <= start_row) return;
+    void set_upper_diagonals(const CbrtMode cbrt_mode = CbrtMode::Exact) const {
+        if (rank >= procs) return;
+        if (distributed) {
+            exchange_halos(cbrt_mode);
+            return;
+        }
 
-        alignas(32) double dot_product[4];
+        instrumentation.start(sizeof(T));
+        if (stream) stream->start([&](const long i) { return data[index(i, i)]; });
+        MPI_Request request = MPI_REQUEST_NULL;
+        std::vector<std::pair<int, int>> ready_rows;
+        std::vector<std::pair<int, int>> deferred_rows;
 
         // Iterate over the diagonals.
-        for (int k = 1; k < size; ++k) {
-
-            // Distribute across the rows.
-            for (int i = start_row; i < end_row && i < size - k; ++i) {
+        for (int k = 1; k <= diagonals; ++k) {
 
-                // Try to prefetch the next iteration first 4 double vectors (row and column) into L3 cache
+            // Double buffering: the buffer of the previous diagonal may still be in use by the all-gather
+            T* const send_buffer = diagonal_buffer + (k % 2) * size;
+            int local_rows = 0;
+            instrumentation.begin_diagonal(k);
+            if (stream) stream->acquire(k);
+            ready_rows.clear();
+            deferred_rows.clear();
 
-                // first element of the row and column
-                if (i + 1 + k and i + 2 < size - k) {
-                    _mm_prefetch(&data[index(i + 1, i + 2)], _MM_HINT_T2);
-                    _mm_prefetch(&data_t[index(i + 1 + k, i + 1)], _MM_HINT_T2);
-                }
-                // second element of the row and column
-                if (i + 1 + k and i + 3 < size - k) {
-                    _mm_prefetch(&data[index(i + 1, i + 3)], _MM_HINT_T2);
-                    _mm_prefetch(&data_t[index(i + 1 + k, i + 2)], _MM_HINT_T2);
-                }
-                // third element of the row and column
-                if (i + 1 + k and i + 4 < size - k) {
-                    _mm_prefetch(&data[index(i + 1, i + 4)], _MM_HINT_T2);
-                    _mm_prefetch(&data_t[index(i + 1 + k, i + 3)], _MM_HINT_T2);
-                }
-                // fourth element of the row and column
-                if (i + 1 + k and i + 5 < size - k) {
-                    _mm_prefetch(&data[index(i + 1, i + 5)], _MM_HINT_T2);
-                    _mm_prefetch(&data_t[index(i + 1 + k, i + 4)], _MM_HINT_T2);
-                }
+            // The partial sums of a band read all the previous diagonals, so their exchange must be complete
+            const bool starts_band = band_start(k) == k && k >= first_band;
+            if (starts_band && k > 1) finish_exchange(k - 1, request);
 
-                // Use AVX to speed up the dot product calculation
-                long j = 0;
-                __m256d sum = _mm256_setzero_pd();
-                for (; j <= k - 4; j += 4) {
-                    const __m256d row = _mm256_loadu_pd(&data[index(i, i + j)]);
-                    const __m256d column = _mm256_loadu_pd(&data_t[index(i + k, i + 1 + j)]);
-                    sum = _mm256_add_pd(sum, _mm256_mul_pd(row, column));
+            // Distribute across the rows, computing first the ones whose elements of the previous diagonal
+            // (in the same row and in the row below) were computed by this process.
+            for_each_row(k, rank, [&](const int i) {
+                if (k == 1 || starts_band || (owner(k - 1, i) == rank && owner(k - 1, i + 1) == rank)) {
+                    ready_rows.emplace_back(local_rows, i);
+                } else {
+                    deferred_rows.emplace_back(local_rows, i);
                 }
+                ++local_rows;
+            });
+            if (starts_band) compute_strips(k, ready_rows);
+            compute_rows(k, ready_rows, send_buffer, request, cbrt_mode);
 
-                // Sum the elements of the AVX register
-                _mm256_store_pd(dot_product, sum);
-                dot_product[0] += dot_product[1] + dot_product[2] + dot_product[3];
-
-                // Handle remaining elements
-                for (; j < k; ++j) {
-                    dot_product[0] += data[index(i, i + j)] * data_t[index(i + k, i + 1 + j) ];
-                }
+            // Complete the exchange of the previous diagonal, then compute the rows that depend on remote values.
+            if (k > 1 && !starts_band) finish_exchange(k - 1, request);
+            compute_rows(k, deferred_rows, send_buffer, request, cbrt_mode);
+            instrumentation.end_diagonal(local_rows, dot_product_length(k));
 
-                // Store the result in the current diagonal
-                const double value = std::cbrt(dot_product[0]);
-                data[index(i, i + k)] = value;
-                data_t[index(i + k, i)] = value;
+            if (mpi_world_size == 1) continue;
 
-                // Store the diagonal element in the buffer for MPI communication
-                diagonal_buffer[i - start_row] = value;
+            // The rows assigned to each process may change with the diagonal
+            for (int proc = 0; proc < procs; ++proc) {
+                recvcounts[proc] = count_rows(k, proc);
+                displs[proc] = (proc == 0) ? 0 : displs[proc - 1] + recvcounts[proc - 1];
             }
 
-            if (mpi_world_size == 1) continue;
-
-            // Blocking gather the diagonal elements
-            MPI_Gatherv(diagonal_buffer, end_row - start_row, MPI_DOUBLE,
-                         combined_diagonal_buffer, recvcounts, displs, MPI_DOUBLE,
-                         0, comm);
-            // Blocking broadcast the combined buffer to all processes
-            MPI_Bcast(combined_diagonal_buffer, static_cast<int>(size) - k, MPI_DOUBLE, 0, comm);
+            // Non-blocking all-gather of the diagonal elements
+            MPI_Iallgatherv(send_buffer, local_rows, datatype(),
+                            combined_diagonal_buffer, recvcounts, displs, datatype(),
+                            comm, &request);
+        }
 
-            // Update the matrix for all the processes.
-            for (int i = 0; i < size - k; ++i) {
-                const double value = combined_diagonal_buffer[i];
-                data[index(i, i + k)] = value;
-                data_t[index(i + k, i)] = value;
-            }
+        if (diagonals > 0) finish_exchange(diagonals, request);
+        if (stream) stream->finish();
+    }
 
+    /**
+     * \brief Stream the diagonals of the next sweeps to a consumer, on its own thread, as Matrix::stream_diagonals(),
+     * on each process with rows assigned, once the elements of the other processes are gathered.
+     * A diagonal is computed while the previous one is exchanged, so the sweep is at least 2 diagonals ahead.
+     * \param consumer The consumer, or an empty function to stop streaming.
+     * \param depth The number of diagonals computed ahead of the consumer (default is 2, at least 2).
+     * \throw std::invalid_argument with the distributed partitioning, where no process holds the whole diagonals.
+     */
+    void stream_diagonals(DiagonalConsumer consumer, const long depth = 2) {
+        if (consumer && distributed) {
+            throw std::invalid_argument("The diagonals cannot be streamed with the distributed partitioning");
+        }
+        stream.reset();
+        if (consumer && rank < procs) {
+            stream = std::make_unique<DiagonalStream<T>>(size, std::move(consumer), std::max(depth, 2L));
         }
     }
 
     /**
-     * \brief Print the matrix to the standard output.
+     * \brief Print the rows of the matrix stored on this process to the standard output, with zeros out of the band.
      */
     void print() const {
         std::ostringstream oss;
-        for (long i = 0; i < size; ++i) {
+        for (long i = origin; i < rows_end; ++i) {
             for (long j = 0; j < size; ++j) {
-                if (j >= i) {
+                if (j >= i && j <= last_column(i)) {
                     oss << std::setw(9) << std::setprecision(6) << std::fixed << data[index(i, j)] << " ";
                 } else {
                     oss << std::setw(10) << "0 ";
@@ -174,32 +299,639 @@ public:
         std::cout << oss.str() << std::flush;
     }
 
+    /**
+     * \brief Get an element of the upper triangle (on the processes with rows assigned, with the distributed
+     * partitioning on the one that owns the row).
+     * \param row The row of the element.
+     * \param column The column of the element (row <= column <= row + get_diagonals()).
+     * \return The element, widened to double.
+     */
+    [[nodiscard]] double get(const long row, const long column) const {
+        return data[index(row, column)];
+    }
+
+    /**
+     * \brief Get the number of upper diagonals stored and computed.
+     * \return The width of the band, size - 1 for the whole triangle.
+     */
+    [[nodiscard]] int get_diagonals() const {
+        return diagonals;
+    }
+
+    /**
+     * \brief Compare the upper triangle with the one of another matrix of the same size, on the diagonals stored by
+     * both. With the distributed partitioning, the other matrix must have the same processes and partitioning,
+     * and it must be called by all the processes.
+     * \tparam U The type of the elements of the other matrix.
+     * \param other The reference matrix.
+     * \return The maximum relative error of the elements with respect to the reference (0 on the processes without
+     * rows assigned).
+     */
+    template <typename U, typename OtherCell>
+    [[nodiscard]] double max_relative_error(const MPIMatrix<U, OtherCell>& other) const {
+        if (rank >= procs) return 0.0;
+
+        double error = 0.0;
+        for (long i = origin; i < rows_end; ++i) {
+            for (long j = i; j <= std::min(last_column(i), i + other.get_diagonals()); ++j) {
+                const double reference = other.get(i, j);
+                error = std::max(error, std::abs(get(i, j) - reference) / std::abs(reference));
+            }
+        }
+        if (distributed && comm != MPI_COMM_NULL) {
+            MPI_Allreduce(MPI_IN_PLACE, &error, 1, MPI_DOUBLE, MPI_MAX, comm);
+        }
+        return error;
+    }
+
+    /**
+     * \brief Compute the checksum of the matrix, to compare the results of the backends.
+     * With the distributed partitioning, the running sum is passed from each process to the next one, so that the
+     * elements are still added row by row, in the same order as the other partitionings; it must be called by all the
+     * processes. Only the summation order is the same: the distributed sweep has no register blocking, so its
+     * elements, and the checksum, may differ from the other partitionings in the last bits.
+     * \return The sum of the elements of the upper triangle (of the band), row by row (0 on the processes without
+     * rows assigned).
+     */
+    [[nodiscard]] double checksum() const {
+        if (rank >= procs) return 0.0;
+
+        double sum = 0.0;
+        if (distributed && rank > 0) {
+            MPI_Recv(&sum, 1, MPI_DOUBLE, rank - 1, 0, comm, MPI_STATUS_IGNORE);
+        }
+        for (long i = origin; i < rows_end; ++i) {
+            const T* const row = &data[index(i, i)];
+            for (long c = 0; c <= last_column(i) - i; ++c) {
+                sum += row[c];
+            }
+        }
+        if (distributed && procs > 1) {
+            if (rank + 1 < procs) MPI_Send(&sum, 1, MPI_DOUBLE, rank + 1, 0, comm);
+            MPI_Bcast(&sum, 1, MPI_DOUBLE, procs - 1, comm);
+        }
+        return sum;
+    }
+
+    /**
+     * \brief Save the packed upper triangle in a binary file, as Matrix::save(), with a collective MPI-IO write:
+     * after the sweep each process with rows assigned holds the whole triangle, so each one writes an equal share of
+     * its elements; with the distributed partitioning, each one writes its rows. It must be called by all the
+     * processes.
+     * \param path The path of the file, replaced if it exists.
+     * \throw std::invalid_argument if the matrix only holds a band of the triangle.
+     * \throw std::runtime_error if the file cannot be written.
+     */
+    void save(const std::string& path) const {
+        if (banded) {
+            throw std::invalid_argument("Only the whole upper triangle can be saved, not a band");
+        }
+        if (rank >= procs) return;
+
+        const MPI_Comm file_comm = comm == MPI_COMM_NULL ? MPI_COMM_SELF : comm;
+        MPI_File file;
+        if (MPI_File_open(file_comm, path.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &file) !=
+            MPI_SUCCESS) {
+            throw std::runtime_error("Could not open " + path);
+        }
+        const long elements = triangle_elements(size);
+        const auto bytes = static_cast<MPI_Offset>(triangle_data_offset + elements * sizeof(T));
+        int written = MPI_File_set_size(file, bytes) == MPI_SUCCESS;
+        const double sum = checksum();
+        if (rank == 0) {
+            const TriangleHeader header = triangle_header<T>(size, sum);
+            written &= MPI_File_write_at(file, 0, &header, sizeof(header), MPI_BYTE, MPI_STATUS_IGNORE) ==
+                       MPI_SUCCESS;
+        }
+
+        // The same number of collective writes on all the processes, each of at most the largest int elements.
+        // The rows of a process are contiguous in the packed triangle, from the element (origin, origin) on.
+        const long stored = static_cast<long>(origin) * (2 * size - origin + 1) / 2;
+        const long first = distributed ? stored : elements * rank / procs;
+        const long last = distributed ? stored + stored_elements(rows_end - origin) : elements * (rank + 1) / procs;
+        const long piece = std::numeric_limits<int>::max();
+        const long pieces = distributed ? (elements + piece - 1) / piece
+                                        : ((elements + procs - 1) / procs + piece - 1) / piece;
+        for (long p = 0; p < pieces; ++p) {
+            const long begin = std::min(first + p * piece, last);
+            const auto count = static_cast<int>(std::min(piece, last - begin));
+            const auto offset = static_cast<MPI_Offset>(triangle_data_offset + begin * sizeof(T));
+            written &= MPI_File_write_at_all(file, offset, data + begin - stored, count, datatype(),
+                                             MPI_STATUS_IGNORE) == MPI_SUCCESS;
+        }
+        written &= MPI_File_close(&file) == MPI_SUCCESS;
+
+        MPI_Allreduce(MPI_IN_PLACE, &written, 1, MPI_INT, MPI_LAND, file_comm);
+        if (!written) {
+            throw std::runtime_error("Could not write " + path);
+        }
+    }
+
+    /**
+     * \brief Get the trace of the last computation of the upper diagonals on this process.
+     * It is empty without SPM_INSTRUMENT.
+     * \return The trace.
+     */
+    [[nodiscard]] const Instrumentation& get_instrumentation() const {
+        return instrumentation;
+    }
+
+protected:
+
+    /**
+     * \brief Compute some rows of a diagonal, storing their elements in the matrix and in the send buffer.
+     * \param k The diagonal.
+     * \param rows The rows to compute, as pairs of position in the send buffer and row index.
+     * \param send_buffer The buffer of the diagonal elements computed by this process.
+     * \param request The request of the exchange in flight (MPI_REQUEST_NULL if there is none).
+     * \param cbrt_mode The accuracy of the cubic roots.
+     */
+    virtual void compute_rows(const int k, const std::vector<std::pair<int, int>>& rows, T* const send_buffer,
+                              MPI_Request& request, const CbrtMode cbrt_mode) const {
+        const auto chunk = static_cast<std::size_t>(tuning.chunk);
+        for (std::size_t first = 0; first < rows.size(); first += chunk) {
+            compute_batch(k, rows, first, std::min(first + chunk, rows.size()), send_buffer, cbrt_mode);
+
+            // Let MPI progress the exchange of the previous diagonal
+            if (request != MPI_REQUEST_NULL) {
+                int completed;
+                MPI_Test(&request, &completed, MPI_STATUS_IGNORE);
+            }
+        }
+    }
+
+    /**
+     * \brief Compute a batch of rows of a diagonal, storing their elements in the matrix and in the send buffer.
+     * The cubic roots of the batch are computed together.
+     * \param k The diagonal.
+     * \param rows The rows of the diagonal, as pairs of position in the send buffer and row index.
+     * \param first The first row of the batch in rows.
+     * \param last The row past the last one of the batch in rows (at most cbrt_batch_size after the first one).
+     * \param send_buffer The buffer of the diagonal elements computed by this process.
+     * \param cbrt_mode The accuracy of the cubic roots.
+     */
+    void compute_batch(const int k, const std::vector<std::pair<int, int>>& rows, const std::size_t first,
+                       const std::size_t last, T* const send_buffer, const CbrtMode cbrt_mode) const {
+        const auto work = instrumentation.work();
+        double sums[cbrt_batch_size];
+        for (std::size_t r = first; r < last; ++r) {
+            sums[r - first] = element_sum(rows[r].second, k);
+        }
+        cell.finalize(sums, static_cast<long>(last - first), cbrt_mode);
+
+        // Store the results in the current diagonal, and in its slot of the stream
+        T* const diagonal = stream ? stream->slot(k) : nullptr;
+        for (std::size_t r = first; r < last; ++r) {
+            const auto& [position, i] = rows[r];
+            const auto value = static_cast<T>(sums[r - first]);
+            data[index(i, i + k)] = value;
+            data_t[transposed_index(i + k, i)] = value;
+            send_buffer[position] = value;
+            if (diagonal != nullptr) diagonal[i] = value;
+        }
+    }
+
+    /**
+     * \brief Set the upper diagonals with the distributed partitioning, exchanging the columns of the transpose
+     * between neighbours.
+     * During diagonal k a process reads only the columns from origin + k to rows_end - 1 + k, its window, which slides
+     * by one column per diagonal: the column origin + k leaves it once diagonal k computed its last element, and the
+     * column rows_end + k enters it. The next process computed the rows of the entering column below this process,
+     * and the column leaving its own window is that one, complete: so after each diagonal every process sends the
+     * column leaving its window to the previous one, which receives it into the slot just freed by its own one.
+     * Only the last row of a process reads the entering column in the diagonal it enters, so it is computed once the
+     * column is received, the other rows while it is in flight. Each process sends each column once, the segment of
+     * its rows and the ones below.
+     * \param cbrt_mode The accuracy of the cubic roots.
+     */
+    void exchange_halos(const CbrtMode cbrt_mode) const {
+        instrumentation.start(sizeof(T));
+        MPI_Request send_requests[2] = {MPI_REQUEST_NULL, MPI_REQUEST_NULL};
+        MPI_Request request = MPI_REQUEST_NULL;
+        std::vector<std::pair<int, int>> ready_rows;
+        std::vector<std::pair<int, int>> deferred_rows;
+
+        // The window starts with the columns of the owned rows, of which only the main diagonal is known
+        for (int c = origin; c < rows_end; ++c) {
+            data_t[transposed_index(c, c)] = data[index(c, c)];
+        }
+        if (diagonals > 0) send_column(0, send_requests[0]);
+
+        for (int k = 1; k <= diagonals; ++k) {
+            // Double buffering: the buffer of diagonal k - 2 may still be in use by its send
+            T* const send_buffer = diagonal_buffer + (k % 2) * size;
+            int local_rows = 0;
+            instrumentation.begin_diagonal(k);
+            const int column = rows_end - 1 + k;
+            if (rank + 1 < procs && column < size) {
+                const int first = std::max(column - diagonals, rows_end);
+                MPI_Irecv(&data_t[transposed_index(column, first)], column - first + 1, datatype(), rank + 1, k - 1,
+                          comm, &request);
+            }
+            {
+                const auto communication = instrumentation.communication();
+                MPI_Wait(&send_requests[k % 2], MPI_STATUS_IGNORE);
+            }
+
+            ready_rows.clear();
+            deferred_rows.clear();
+            for_each_row(k, rank, [&](const int i) {
+                if (i + 1 == rows_end && rank + 1 < procs) {
+                    deferred_rows.emplace_back(local_rows, i);
+                } else {
+                    ready_rows.emplace_back(local_rows, i);
+                }
+                ++local_rows;
+            });
+            compute_rows(k, ready_rows, send_buffer, request, cbrt_mode);
+            {
+                const auto communication = instrumentation.communication();
+                MPI_Wait(&request, MPI_STATUS_IGNORE);
+            }
+            compute_rows(k, deferred_rows, send_buffer, request, cbrt_mode);
+            instrumentation.end_diagonal(local_rows, dot_product_length(k));
+
+            // The next diagonal of the previous process reads this column at least
+            if (k < diagonals) send_column(k, send_requests[k % 2]);
+            diagonal_done(k);
+        }
+
+        MPI_Waitall(2, send_requests, MPI_STATUSES_IGNORE);
+    }
+
+    /**
+     * \brief Compute the partial sums of some rows for the band of diagonals starting at k.
+     * \param k The first diagonal of the band.
+     * \param rows The rows to compute, as pairs of position in the send buffer and row index.
+     */
+    virtual void compute_strips(const int k, const std::vector<std::pair<int, int>>& rows) const {
+        for (const auto& [position, i] : rows) {
+            compute_strip(i, k);
+        }
+    }
+
+    /**
+     * \brief Compute the partial sums of a row for the band of diagonals starting at k.
+     * They are the terms that only read the diagonals before the band, and they share the same row segment.
+     * \param i The row.
+     * \param k The first diagonal of the band.
+     */
+    void compute_strip(const int i, const int k) const {
+        const auto work = instrumentation.work();
+        const int band = std::min(static_cast<int>(strip_width), diagonals + 1 - k);
+        const long first = i + band - 1;
+        const int elements = std::min(band, size - k - i);
+
+        // The columns past the band or the matrix reuse the first one, their results are discarded
+        const T* columns[strip_width];
+        for (int s = 0; s < strip_width; ++s) {
+            columns[s] = &data_t[transposed_index(i + k + (s < elements ? s : 0), first + 1)];
+        }
+        dot_product_strip_kernel<T>(&data[index(i, first)], columns, k - band + 1, &partial_sums[i * strip_width]);
+    }
+
+    /**
+     * \brief Compute the reduction of an element of the upper diagonals from the corresponding row and column
+     * (see Cell::reduce(), the dot product by default).
+     * In a band of diagonals, the partial sum computed by compute_strip() is completed with the terms that read the band.
+     * \param i The row of the element.
+     * \param k The diagonal of the element.
+     * \return The reduction of the element.
+     */
+    [[nodiscard]] double element_sum(const int i, const int k) const {
+        if (k >= first_band) {
+            const int start = band_start(k);
+            const int band = std::min(static_cast<int>(strip_width), diagonals + 1 - start);
+            const int column = i + k;
+            return dot_product(i, column, i, i + band - 1) + partial_sums[i * strip_width + k - start] +
+                   dot_product(i, column, i + start, column);
+        }
+
+        // Prefetch the first elements of the row and column of a next iteration into L3 cache
+        prefetch_row(i, k);
+
+        // Reduction of the row and column, the SIMD dot product kernel selected at startup by default
+        return cell.reduce(&data[index(i, i)], &data_t[transposed_index(i + k, i + 1)], i, i + k);
+    }
+
 private:
 
     const int size; ///< The size of the matrix (number of rows and columns).
+    const int diagonals; ///< The number of upper diagonals stored and computed (size - 1 for the whole triangle).
+    const bool banded; ///< Whether only a band of the triangle is stored, in strides of diagonals + 1 elements.
     const int rank; ///< The rank of this MPI process.
     const int mpi_world_size; ///< The number of MPI processes.
+    const int procs; ///< The number of MPI processes with rows assigned (the ones in the communicator).
+    const Partitioning partitioning; ///< The strategy used to assign the rows of each diagonal to the processes.
+    const int cyclic_block; ///< The number of rows of a block for the block-cyclic partitioning.
     const int rows_per_proc; ///< The number of rows per MPI process.
     const int remainder; ///< The remainder when size is divided by the number of MPI processes.
-    const int start_row; ///< The starting row for this MPI process.
-    const int end_row; ///< The ending row for this MPI process.
+    const bool distributed; ///< Whether each process stores only its rows (the distributed partitioning).
+    const int origin; ///< The first row stored, the first owned one with the distributed partitioning (else 0).
+    const int rows_end; ///< The row past the last one stored, past the last owned one when distributed (else size).
+    const int window; ///< The columns of the transpose stored, one per owned row when distributed (else size).
+    const int column_length; ///< The elements stored of each column of the transpose when distributed (else unused).
+    const int first_band; ///< The first diagonal computed in bands (diagonals + 1 without register blocking).
+    const TuningSettings tuning; ///< The kernel settings of the tuning profile for the size of the matrix.
+    const Cell cell; ///< The cell of the recurrence.
 
-    double* __restrict__ const data; ///< The data buffer for the matrix.
-    double* __restrict__ const data_t; ///< The data buffer for the matrix transposed.
-    double* __restrict__ const diagonal_buffer; ///< Buffer for diagonal elements.
-    double* __restrict__ const combined_diagonal_buffer; ///< Buffer for combined diagonal elements.
+    const Storage<T> data_storage; ///< The storage of the matrix.
+    const Storage<T> data_t_storage; ///< The storage of the matrix transposed.
+    T* __restrict__ const data; ///< The data buffer for the matrix.
+    T* __restrict__ const data_t; ///< The data buffer for the matrix transposed.
+    T* __restrict__ const diagonal_buffer; ///< Two buffers for the diagonal elements computed by this process.
+    T* __restrict__ const combined_diagonal_buffer; ///< Buffer for combined diagonal elements.
     int* __restrict__ const recvcounts; ///< The number of elements to receive from each process.
     int* __restrict__ const displs; ///< The displacement of the receive buffer for each process.
+    double* __restrict__ const partial_sums; ///< The partial sums of the current band, strip_width per row.
     MPI_Comm comm{MPI_COMM_NULL};
+    mutable Instrumentation instrumentation; ///< The trace of the last computation of the upper diagonals.
+    std::unique_ptr<DiagonalStream<T>> stream; ///< The stream of the diagonals to a consumer, if any.
+
+    /**
+     * \brief Prefetch into the L3 cache the first elements of the row and of the column of the element of diagonal k
+     * that is prefetch_distance rows below (i, i + k), as set by the tuning profile.
+     * \param i The row of the element being computed.
+     * \param k The diagonal.
+     */
+    void prefetch_row(const int i, const int k) const {
+        const long next = i + tuning.prefetch_distance;
+        for (long j = 1; tuning.prefetch_distance > 0 && j <= 4 && next + j < size - k && next < rows_end; ++j) {
+            _mm_prefetch(&data[index(next, next + j)], _MM_HINT_T2);
+            _mm_prefetch(&data_t[transposed_index(next + k, next + j - 1)], _MM_HINT_T2);
+        }
+    }
+
+    /**
+     * \brief Wait for the all-gather of a diagonal and copy the elements computed by the other processes into the matrix.
+     * \param k The diagonal.
+     * \param request The request of the all-gather.
+     */
+    void finish_exchange(const int k, MPI_Request& request) const {
+        if (mpi_world_size != 1) {
+            const auto communication = instrumentation.communication();
+            MPI_Wait(&request, MPI_STATUS_IGNORE);
+
+            // Walk the rows of each process in the same order they were gathered.
+            T* const diagonal = stream ? stream->slot(k) : nullptr;
+            for (int proc = 0; proc < procs; ++proc) {
+                if (proc == rank) continue;
+                int position = displs[proc];
+                for_each_row(k, proc, [&](const int i) {
+                    const T value = combined_diagonal_buffer[position++];
+                    data[index(i, i + k)] = value;
+                    data_t[transposed_index(i + k, i)] = value;
+                    if (diagonal != nullptr) diagonal[i] = value;
+                });
+            }
+        }
+
+        diagonal_done(k);
+    }
+
+    /**
+     * \brief Send to the previous process the column leaving the window of the transpose after a diagonal, with the
+     * distributed partitioning: its elements from the first row of this process on (see exchange_halos()).
+     * \param k The diagonal, the column is origin + k.
+     * \param request The request of the send, whose buffer is the one of diagonal k.
+     */
+    void send_column(const int k, MPI_Request& request) const {
+        const int column = origin + k;
+        if (rank == 0 || column >= size) return;
+
+        // The slot of the column receives the entering one during the next diagonal
+        const long first = first_row(column);
+        const auto count = static_cast<int>(column - first + 1);
+        T* const buffer = diagonal_buffer + (k % 2) * size;
+        std::copy_n(&data_t[transposed_index(column, first)], count, buffer);
+        MPI_Isend(buffer, count, datatype(), rank - 1, k, comm, &request);
+    }
+
+    /**
+     * \brief Get the MPI datatype of the elements.
+     * \return MPI_FLOAT or MPI_DOUBLE.
+     */
+    [[nodiscard]] static MPI_Datatype datatype() {
+        return std::is_same_v<T, float> ? MPI_FLOAT : MPI_DOUBLE;
+    }
+
+    /**
+     * \brief Pass a complete diagonal to the consumer of the stream, if any, and hint the storage that it is complete,
+     * when the matrix is in memory-mapped files.
+     * After diagonal k the row size - 1 - k of the matrix and the column origin + k of the transposed matrix are
+     * never read again (see Matrix::diagonal_done()), and the next diagonal starts reading both from their first
+     * rows again. With the distributed partitioning, the window of the transpose is read by every diagonal, as its
+     * slots are reused by the entering columns, so only the matrix is hinted.
+     * \param k The diagonal.
+     */
+    void diagonal_done(const int k) const {
+        if (stream) stream->publish(k);
+
+        const int row = size - 1 - k;
+        const int column = origin + k;
+        if (row >= origin && row < rows_end) data_storage.done(index(row, row), index(row, size - 1) + 1);
+        if (column < size && !distributed) data_t_storage.done(transposed_index(column, first_row(column)),
+                                                               transposed_index(column, column) + 1);
+
+        if (k < diagonals && column + 1 < size) {
+            data_storage.will_need(0, storage_readahead);
+            if (!distributed) {
+                const long next = transposed_index(column + 1, first_row(column + 1));
+                data_t_storage.will_need(next, next + storage_readahead);
+            }
+        }
+    }
+
+    /**
+     * \brief Get the first diagonal of the band that contains a diagonal.
+     * \param k The diagonal.
+     * \return The first diagonal of the band, k itself if it is not computed in bands.
+     */
+    [[nodiscard]] int band_start(const int k) const {
+        return k < first_band ? k : first_band + (k - first_band) / strip_width * strip_width;
+    }
+
+    /**
+     * \brief Get the length of the dot product of each element of a diagonal, for the trace.
+     * \param k The diagonal.
+     * \return The length of the dot product, including the partial sums at the start of a band.
+     */
+    [[nodiscard]] long dot_product_length(const int k) const {
+        if (k < first_band) return k;
+        const int start = band_start(k);
+        return band_dot_product_length(start, k - start,
+                                       std::min(static_cast<int>(strip_width), diagonals + 1 - start));
+    }
+
+    /**
+     * \brief Compute the partial dot product used by the element (row, column) of the upper diagonals.
+     * It sums data(row, m) * data(m + 1, column) for m in [first, last).
+     * \param row The row of the element.
+     * \param column The column of the element.
+     * \param first The first index of the partial sum.
+     * \param last The index past the last one of the partial sum.
+     * \return The partial dot product.
+     */
+    [[nodiscard]] double dot_product(const long row, const long column, const long first, const long last) const {
+        if (last <= first) return 0.0;
+
+        return dot_product_kernel<T>(&data[index(row, first)], &data_t[transposed_index(column, first + 1)],
+                                     last - first);
+    }
+
+    /**
+     * \brief Get the process that a row of a diagonal is assigned to.
+     * \param k The diagonal.
+     * \param i The row.
+     * \return The rank of the process.
+     */
+    [[nodiscard]] int owner(const int k, const int i) const {
+        switch (partitioning) {
+            case Partitioning::Block:
+            case Partitioning::Distributed: {
+                const int large_rows = remainder * (rows_per_proc + 1);
+                return i < large_rows ? i / (rows_per_proc + 1) : remainder + (i - large_rows) / rows_per_proc;
+            }
+            case Partitioning::BlockCyclic:
+                return i / cyclic_block % procs;
+            case Partitioning::Rebalanced: {
+                // The rows are split at the start of the band, so that they do not move inside it
+                const long rows = size - band_start(k);
+                int proc = static_cast<int>(std::min<long>(procs - 1, i * procs / rows));
+                while (proc > 0 && rows * proc / procs > i) --proc;
+                while (proc < procs - 1 && rows * (proc + 1) / procs <= i) ++proc;
+                return proc;
+            }
+        }
+        return 0;
+    }
+
+    /**
+     * \brief Call a function on each row of a diagonal assigned to a process, in ascending order.
+     * \param k The diagonal.
+     * \param proc The rank of the process.
+     * \param function The function to call with the row index.
+     */
+    template <typename Function>
+    void for_each_row(const int k, const int proc, Function&& function) const {
+        const int rows = size - k;
+        switch (partitioning) {
+            case Partitioning::Block:
+            case Partitioning::Distributed: {
+                const int last = std::min(block_begin(proc + 1), rows);
+                for (int i = block_begin(proc); i < last; ++i) function(i);
+                break;
+            }
+            case Partitioning::BlockCyclic: {
+                for (int first = proc * cyclic_block; first < rows; first += procs * cyclic_block) {
+                    const int last = std::min(first + cyclic_block, rows);
+                    for (int i = first; i < last; ++i) function(i);
+                }
+                break;
+            }
+            case Partitioning::Rebalanced: {
+                const long split_rows = size - band_start(k);
+                const int first = static_cast<int>(split_rows * proc / procs);
+                const int last = std::min(static_cast<int>(split_rows * (proc + 1) / procs), rows);
+                for (int i = first; i < last; ++i) function(i);
+                break;
+            }
+        }
+    }
 
     /**
-     * \brief Calculate the index in the 1D array for a given row and column.
-     * \param row The row index.
-     * \param column The column index.
+     * \brief Get the first row of the block of a process, with the block and distributed partitionings.
+     * \param proc The rank of the process, procs for the row past the last block.
+     * \return The first row of the block.
+     */
+    [[nodiscard]] int block_begin(const int proc) const {
+        return proc * rows_per_proc + std::min(proc, remainder);
+    }
+
+    /**
+     * \brief Count the rows of a diagonal assigned to a process.
+     * \param k The diagonal.
+     * \param proc The rank of the process.
+     * \return The number of rows.
+     */
+    [[nodiscard]] int count_rows(const int k, const int proc) const {
+        const int rows = size - k;
+        switch (partitioning) {
+            case Partitioning::Block:
+            case Partitioning::Distributed: {
+                const int first = block_begin(proc);
+                return std::max(std::min(block_begin(proc + 1), rows) - first, 0);
+            }
+            case Partitioning::BlockCyclic: {
+                const int cycle = procs * cyclic_block;
+                return rows / cycle * cyclic_block + std::clamp(rows % cycle - proc * cyclic_block, 0, cyclic_block);
+            }
+            case Partitioning::Rebalanced: {
+                const long split_rows = size - band_start(k);
+                const int first = static_cast<int>(split_rows * proc / procs);
+                const int last = std::min(static_cast<int>(split_rows * (proc + 1) / procs), rows);
+                return std::max(last - first, 0);
+            }
+        }
+        return 0;
+    }
+
+    /**
+     * \brief Get the number of elements of the first rows of the storage of the matrix from the origin,
+     * the sub-triangle of the rows from the origin on (or its band).
+     * \param rows The number of rows, size for the storage of the transpose (without the distributed partitioning).
+     * \return The number of elements, in strides of diagonals + 1 elements in a band.
+     */
+    [[nodiscard]] long stored_elements(const long rows) const {
+        const long extent = size - origin;
+        return banded ? rows * (diagonals + 1) : rows * (2 * extent - rows + 1) / 2;
+    }
+
+    /**
+     * \brief Calculate the index in the 1D array for a given row and column, as Matrix::index().
+     * The rows are stored from the origin on, as the packed triangle of the rows below it (or its band).
+     * \param row The row index (origin <= row < rows_end).
+     * \param column The column index (row <= column <= row + diagonals).
      * \return The index in the 1D array.
      */
     [[nodiscard]] long index(const long row, const long column) const {
-        return row * (2 * size - row + 1) / 2 + column - row;
+        const long r = row - origin;
+        if (banded) return r * (diagonals + 1) + column - row;
+        return r * (2 * (size - origin) - r + 1) / 2 + column - row;
+    }
+
+    /**
+     * \brief Calculate the index in the 1D array of the transposed matrix for a given row and column,
+     * as Matrix::transposed_index(). With the distributed partitioning, the rows of the transpose in the window are
+     * stored in a ring of window slots of column_length elements, each one ending with the main diagonal.
+     * \param row The row index in the transposed matrix (column of the matrix), in the window when distributed.
+     * \param column The column index in the transposed matrix (row of the matrix), with
+     * max(row - diagonals, origin) <= column <= row.
+     * \return The index in the 1D array.
+     */
+    [[nodiscard]] long transposed_index(const long row, const long column) const {
+        const long r = row - origin;
+        if (distributed) return r % window * column_length + column_length - 1 - row + column;
+        if (banded) return r * (diagonals + 1) + diagonals - row + column;
+        return r * (r + 1) / 2 + column - origin;
+    }
+
+    /**
+     * \brief Get the last column of a row that is stored.
+     * \param row The row.
+     * \return The last column of the band in the row, size - 1 for the whole triangle.
+     */
+    [[nodiscard]] long last_column(const long row) const {
+        return std::min<long>(row + diagonals, size - 1);
+    }
+
+    /**
+     * \brief Get the first row of a column that is stored in the transpose.
+     * \param column The column.
+     * \return The first row of the band in the column from the origin on, the origin for the whole triangle.
+     */
+    [[nodiscard]] long first_row(const long column) const {
+        return std::max<long>(column - diagonals, origin);
     }
 
 };
@@ -0,0 +1,185 @@
+#ifndef SPM_OMPMATRIX_H
+#define SPM_OMPMATRIX_H
+
+#include <omp.h>
+#include <algorithm>
+#include <vector>
+
+#include "../utils/matrix.h"
+
+/**
+ * \brief The OpenMP construct that splits the rows of a diagonal among the threads.
+ */
+enum class OmpLoop {
+    For, ///< A worksharing loop with static chunks, all the threads sweeping the diagonals together.
+    Taskloop ///< A task per chunk of rows, created by one thread and taken by the idle ones.
+};
+
+/**
+ * \brief A class to represent an upper triangular matrix with parallel computation (using OpenMP) of the upper
+ * diagonals.
+ * \tparam T The type of the stored elements (double or float).
+ * \tparam Cell The recurrence of the upper diagonals (see Matrix).
+ */
+template <typename T = double, typename Cell = CbrtDotProduct>
+class OMPMatrix final : public Matrix<T, Cell> {
+
+protected:
+
+    using Matrix<T, Cell>::size;
+    using Matrix<T, Cell>::diagonals;
+    using Matrix<T, Cell>::start_sweep;
+    using Matrix<T, Cell>::begin_diagonal;
+    using Matrix<T, Cell>::diagonal_done;
+    using Matrix<T, Cell>::finish_sweep;
+    using Matrix<T, Cell>::first_band_diagonal;
+    using Matrix<T, Cell>::compute_diagonal_chunk;
+    using Matrix<T, Cell>::compute_strips;
+    using Matrix<T, Cell>::compute_band_chunk;
+    using Matrix<T, Cell>::instrumentation;
+    using Matrix<T, Cell>::tuning;
+
+public:
+
+    /**
+     * \brief Constructor to initialize the matrix with a given size.
+     * \param size The size of the matrix (number of rows and columns).
+     */
+    explicit OMPMatrix(const long size) : Matrix<T, Cell>(size) {}
+
+    /**
+     * \brief Constructor to initialize the matrix with a given main diagonal.
+     * \param size The size of the matrix (number of rows and columns).
+     * \param diagonal The main diagonal, size elements (empty for the default one).
+     * \param cell The cell of the recurrence (default is a default-constructed one).
+     * \param diagonals The number of upper diagonals stored and computed (default is 0, which means all of them).
+     */
+    OMPMatrix(const long size, const std::vector<double>& diagonal, const Cell& cell = {}, const long diagonals = 0) :
+    Matrix<T, Cell>(size, diagonal, cell, diagonals) {}
+
+    /**
+     * \brief Set the upper diagonals of the matrix in parallel, as FFMatrix::set_upper_diagonals().
+     * The whole sweep runs in one parallel region. With worksharing loops, all the threads walk the diagonals and
+     * meet at the implicit barrier of each loop; with taskloops, one thread walks them and creates a task per chunk,
+     * waiting for the tasks of each loop.
+     * \param maxnw The number of threads (default is 0, which means the one of the tuning profile or the OpenMP
+     * default).
+     * \param register_blocking Whether to compute the diagonals in bands with the strip kernel (default is true).
+     * \param cbrt_mode The accuracy of the cubic roots (default is exact).
+     * \param loop The construct that splits the rows of each diagonal (default is a worksharing loop).
+     */
+    void set_upper_diagonals(const long maxnw = 0, const bool register_blocking = true,
+                             const CbrtMode cbrt_mode = CbrtMode::Exact, const OmpLoop loop = OmpLoop::For) const {
+        const long nw = maxnw > 0 ? maxnw : tuning.workers > 0 ? tuning.workers : omp_get_max_threads();
+        const long first_band = first_band_diagonal(register_blocking);
+        std::vector<double> partial_sums(std::max(size - first_band, 0L) * strip_width);
+        start_sweep();
+
+        #pragma omp parallel num_threads(nw)
+        {
+            if (loop == OmpLoop::Taskloop) {
+                #pragma omp single
+                sweep(first_band, partial_sums.data(), nw, loop, cbrt_mode);
+            } else {
+                sweep(first_band, partial_sums.data(), nw, loop, cbrt_mode);
+            }
+        }
+        finish_sweep();
+    }
+
+private:
+
+    /**
+     * \brief Sweep the diagonals, from inside the parallel region: called by all the threads with worksharing loops,
+     * by one thread with taskloops.
+     * \param first_band The first diagonal computed in bands.
+     * \param partial_sums The partial sums of the current band, shared by the threads.
+     * \param nw The number of threads.
+     * \param loop The construct that splits the rows of each diagonal.
+     * \param cbrt_mode The accuracy of the cubic roots.
+     */
+    void sweep(const long first_band, double* const partial_sums, const long nw, const OmpLoop loop,
+               const CbrtMode cbrt_mode) const {
+
+        // Iterate over upper diagonals
+        for (long k = 1; k < first_band; ++k) {
+            serial(loop, [&]() { begin_diagonal(k); });
+            for_rows(size - k, nw, loop, [&](const long first, const long last) {
+                compute_diagonal_chunk(k, first, last, cbrt_mode);
+            });
+            serial(loop, [&]() {
+                instrumentation.end_diagonal(size - k, k);
+                diagonal_done(k);
+            });
+        }
+
+        // Iterate over the bands of upper diagonals
+        for (long k = first_band; k <= diagonals; k += strip_width) {
+            const long band = std::min(strip_width, diagonals + 1 - k);
+
+            // The partial sums of the band (traced with its first diagonal), then its diagonals one by one
+            serial(loop, [&]() { begin_diagonal(k); });
+            for_rows(size - k, nw, loop, [&](const long first, const long last) {
+                compute_strips(k, band, first, last, partial_sums);
+            });
+            for (long s = 0; s < band; ++s) {
+                if (s > 0) serial(loop, [&]() { begin_diagonal(k + s); });
+                for_rows(size - k - s, nw, loop, [&](const long first, const long last) {
+                    compute_band_chunk(k, s, band, first, last, partial_sums, cbrt_mode);
+                });
+                serial(loop, [&]() {
+                    instrumentation.end_diagonal(size - k - s, band_dot_product_length(k, s, band));
+                    diagonal_done(k + s);
+                });
+            }
+        }
+    }
+
+    /**
+     * \brief Run a loop over the rows of a diagonal in chunks, split among the threads, and wait for all of them.
+     * With worksharing loops, the chunks are as large as possible to keep all the threads busy; with taskloops,
+     * there are about four per thread, so that the idle threads take the ones left.
+     * \param rows The number of rows.
+     * \param nw The number of threads.
+     * \param loop The construct that splits the rows.
+     * \param body The body, called with the first row and the row past the last one of each chunk.
+     */
+    template <typename Body>
+    void for_rows(const long rows, const long nw, const OmpLoop loop, const Body& body) const {
+        if (loop == OmpLoop::Taskloop) {
+            const long chunk = std::clamp(rows / (4 * nw), 1L, tuning.chunk);
+            #pragma omp taskloop grainsize(1)
+            for (long first = 0; first < rows; first += chunk) {
+                const auto work = instrumentation.work();
+                body(first, std::min(first + chunk, rows));
+            }
+        } else {
+            const long chunk = std::clamp((rows + nw - 1) / nw, 1L, tuning.chunk);
+            #pragma omp for schedule(static)
+            for (long first = 0; first < rows; first += chunk) {
+                const auto work = instrumentation.work();
+                body(first, std::min(first + chunk, rows));
+            }
+        }
+    }
+
+    /**
+     * \brief Run a function on one thread between the loops: with worksharing loops, the other threads wait for it
+     * at the implicit barrier; with taskloops, it already runs on the only thread walking the diagonals.
+     * \param loop The construct that splits the rows.
+     * \param function The function.
+     */
+    template <typename Function>
+    static void serial(const OmpLoop loop, const Function& function) {
+        if (loop == OmpLoop::Taskloop) {
+            function();
+            return;
+        }
+
+        #pragma omp single
+        function();
+    }
+
+};
+
+#endif //SPM_OMPMATRIX_H
\ No newline at end of file
@@ -0,0 +1,97 @@
+#include <vector>
+#include <omp.h>
+#include <indicators/progress_bar.hpp>
+
+#include "../utils/timer.h"
+#include "../utils/benchmark.h"
+#include "../utils/checks.h"
+
+#include "openmp.h"
+#include "ompmatrix.h"
+#include "../sequential/seqmatrix.h"
+
+/**
+ * \brief Set the upper diagonals of a matrix in parallel, measuring the execution time.
+ * \param matrix The matrix.
+ * \param maxnw The number of threads.
+ * \param loop The construct that splits the rows of each diagonal.
+ * \return The execution time.
+ */
+template <typename T>
+static double compute(const OMPMatrix<T>& matrix, const long maxnw, const OmpLoop loop) {
+    return measureExecutionTime([&matrix, maxnw, loop]() {
+        matrix.set_upper_diagonals(maxnw, true, CbrtMode::Exact, loop);
+    });
+}
+
+bool test_openmp(const long maxnw, const OmpLoop loop, const Precision precision, const BenchmarkOptions& options) {
+    const std::string name = "openmp_" + std::to_string(maxnw) + (loop == OmpLoop::Taskloop ? "_taskloop" : "") +
+                             (precision == Precision::Float ? "_float" : "") + band_suffix(options);
+    BenchmarkReport report{name, "openmp", maxnw <= 0 ? omp_get_max_threads() : maxnw, options,
+                           {{"Loop", loop == OmpLoop::Taskloop ? "taskloop" : "for"},
+                            {"Precision", to_string(precision)}}};
+    bool valid = true;
+
+    std::cout << "Processing in parallel in " << to_string(precision) << " with " << maxnw << " OpenMP threads"
+              << (loop == OmpLoop::Taskloop ? " and taskloops" : "") << "..." << std::endl;
+
+    indicators::ProgressBar bar {
+            indicators::option::BarWidth{50},
+            indicators::option::Start{"["},
+            indicators::option::Fill{"="},
+            indicators::option::Lead{">"},
+            indicators::option::Remainder{" "},
+            indicators::option::End{"]"},
+            indicators::option::PostfixText{"Initializing..."},
+            indicators::option::ForegroundColor{indicators::Color::yellow},
+            indicators::option::ShowElapsedTime{true},
+            indicators::option::ShowRemainingTime{true},
+            indicators::option::MaxProgress{options.dimensions.size()}
+    };
+
+    for (const long dimension : options.dimensions) {
+        bar.set_option(indicators::option::PostfixText{"Processed dimension " + std::to_string(dimension)});
+        std::vector<BenchmarkReport::Field> fields;
+        std::vector<double> times;
+        double checksum;
+        bool saved = true;
+
+        const OMPMatrix matrix{dimension, {}, {}, options.diagonals};
+        if (precision == Precision::Float) {
+            const OMPMatrix<float> float_matrix{dimension, {}, {}, options.diagonals};
+            times = repeat(options, [&]() { return compute(float_matrix, maxnw, loop); });
+            checksum = float_matrix.checksum();
+            write_trace(float_matrix.get_instrumentation(), name, dimension);
+            if (options.save) saved = check_save(float_matrix, name, dimension);
+
+            // The double matrix is the reference for the accuracy of the float one
+            compute(matrix, maxnw, loop);
+            fields.emplace_back("Max Relative Error", toCSVScientificField(float_matrix.max_relative_error(matrix)));
+        } else {
+            times = repeat(options, [&]() { return compute(matrix, maxnw, loop); });
+            checksum = matrix.checksum();
+            write_trace(matrix.get_instrumentation(), name, dimension);
+            if (options.save) saved = check_save(matrix, name, dimension);
+        }
+
+        if (options.check) {
+            // The reference has the same band
+            const SeqMatrix reference{dimension, {}, {}, options.diagonals};
+            reference.set_upper_diagonals();
+            const bool matches = check_checksum(dimension, checksum, reference.checksum(), precision);
+            fields.emplace_back("Checksum Check", matches ? "ok" : "mismatch");
+            valid = valid && matches;
+        }
+
+        if (options.save) {
+            fields.emplace_back("Save Check", saved ? "ok" : "mismatch");
+            valid = valid && saved;
+        }
+
+        report.add(dimension, times, checksum, std::move(fields));
+        bar.tick();
+    }
+
+    report.write();
+    return valid;
+}
\ No newline at end of file
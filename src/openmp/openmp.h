@@ -0,0 +1,9 @@
+#ifndef SPM_OPENMP_H
+#define SPM_OPENMP_H
+
+#include "../utils/benchmark.h"
+#include "ompmatrix.h"
+
+bool test_openmp(long, OmpLoop, Precision, const BenchmarkOptions&);
+
+#endif //SPM_OPENMP_H
\ No newline at end of file
@@ -1,14 +1,41 @@
 #ifndef SPM_SEQMATRIX_H
 #define SPM_SEQMATRIX_H
 
-#include <immintrin.h>
 #include <cmath>
+#include <vector>
 #include "../utils/matrix.h"
 
 /**
  * \brief A class to represent an upper triangular matrix with sequential upper diagonals computation.
+ * \tparam T The type of the stored elements (double or float).
+ * \tparam Cell The recurrence of the upper diagonals (see Matrix).
  */
-class SeqMatrix final : public Matrix {
+template <typename T = double, typename Cell = CbrtDotProduct>
+class SeqMatrix final : public Matrix<T, Cell> {
+
+protected:
+
+    using Matrix<T, Cell>::size;
+    using Matrix<T, Cell>::diagonals;
+    using Matrix<T, Cell>::start_sweep;
+    using Matrix<T, Cell>::begin_diagonal;
+    using Matrix<T, Cell>::diagonal_done;
+    using Matrix<T, Cell>::finish_sweep;
+    using Matrix<T, Cell>::first_band_diagonal;
+    using Matrix<T, Cell>::tile_column_done;
+    using Matrix<T, Cell>::require_whole_triangle;
+    using Matrix<T, Cell>::set_main_diagonal;
+    using Matrix<T, Cell>::affected_chunks;
+    using Matrix<T, Cell>::mark_computed;
+    using Matrix<T, Cell>::is_computed;
+    using Matrix<T, Cell>::missing_chunks;
+    using Matrix<T, Cell>::cone_computed;
+    using Matrix<T, Cell>::compute_diagonal_chunk;
+    using Matrix<T, Cell>::compute_strips;
+    using Matrix<T, Cell>::compute_band_chunk;
+    using Matrix<T, Cell>::compute_tile;
+    using Matrix<T, Cell>::instrumentation;
+    using Matrix<T, Cell>::tuning;
 
 public:
 
@@ -16,68 +43,136 @@ public:
      * \brief Constructor to initialize the sequential matrix with a given size.
      * \param size The size of the matrix (number of rows and columns).
      */
-    explicit SeqMatrix(const long size) : Matrix(size) {}
+    explicit SeqMatrix(const long size) : Matrix<T, Cell>(size) {}
+
+    /**
+     * \brief Constructor to initialize the sequential matrix with a given main diagonal.
+     * \param size The size of the matrix (number of rows and columns).
+     * \param diagonal The main diagonal, size elements (empty for the default one).
+     * \param cell The cell of the recurrence (default is a default-constructed one).
+     * \param diagonals The number of upper diagonals stored and computed (default is 0, which means all of them).
+     */
+    SeqMatrix(const long size, const std::vector<double>& diagonal, const Cell& cell = {}, const long diagonals = 0) :
+    Matrix<T, Cell>(size, diagonal, cell, diagonals) {}
 
     /**
      * \brief Set the upper diagonals of the matrix.
      * Each element of the upper diagonals is the cubic root of the dot product of the corresponding row and column.
+     * With register blocking, the diagonals from strip_width on are computed in bands of strip_width diagonals:
+     * first the partial sums that only read the previous diagonals, with one row segment for the whole band,
+     * then the elements of the band diagonal by diagonal. The result is the same up to floating-point rounding.
+     * The cubic roots are computed in batches of consecutive elements of a diagonal, of the chunk of the tuning
+     * profile, which also sets the prefetch distance. With a band, the sweep stops at its last diagonal.
+     * With SPM_INSTRUMENT, each diagonal is traced (see get_instrumentation()).
+     * \param register_blocking Whether to compute the diagonals in bands with the strip kernel (default is true).
+     * \param cbrt_mode The accuracy of the cubic roots (default is exact).
      */
-    void set_upper_diagonals() const {
-        alignas(32) double dot_product[4];
+    void set_upper_diagonals(const bool register_blocking = true, const CbrtMode cbrt_mode = CbrtMode::Exact) const {
+        const long first_band = first_band_diagonal(register_blocking);
+        start_sweep();
 
         // Iterate over upper diagonals
-        for (long k = 1; k < size; ++k) {
+        for (long k = 1; k < first_band; ++k) {
+            begin_diagonal(k);
 
-            // Iterate over rows
-            for (long i = 0; i < size - k; ++i) {
+            // Iterate over batches of rows
+            for (long first = 0; first < size - k; first += tuning.chunk) {
+                const auto work = instrumentation.work();
+                compute_diagonal_chunk(k, first, std::min(first + tuning.chunk, size - k), cbrt_mode);
+            }
+            instrumentation.end_diagonal(size - k, k);
+            diagonal_done(k);
+        }
 
-                // Try to prefetch the next iteration first two 4 double vectors (row and column) into L3 cache
+        // Iterate over the bands of upper diagonals
+        std::vector<double> partial_sums(std::max(size - first_band, 0L) * strip_width);
+        for (long k = first_band; k <= diagonals; k += strip_width) {
+            const long band = std::min(strip_width, diagonals + 1 - k);
+            begin_diagonal(k);
 
-                // first element of the row and column
-                if (i + 1 + k and i + 2 < size - k) {
-                    _mm_prefetch(&data[index(i + 1, i + 2)], _MM_HINT_T2);
-                    _mm_prefetch(&data_t[index(i + 1 + k, i + 1)], _MM_HINT_T2);
-                }
-                // second element of the row and column
-                if (i + 1 + k and i + 3 < size - k) {
-                    _mm_prefetch(&data[index(i + 1, i + 3)], _MM_HINT_T2);
-                    _mm_prefetch(&data_t[index(i + 1 + k, i + 2)], _MM_HINT_T2);
-                }
-                // third element of the row and column
-                if (i + 1 + k and i + 4 < size - k) {
-                    _mm_prefetch(&data[index(i + 1, i + 4)], _MM_HINT_T2);
-                    _mm_prefetch(&data_t[index(i + 1 + k, i + 3)], _MM_HINT_T2);
-                }
-                // fourth element of the row and column
-                if (i + 1 + k and i + 5 < size - k) {
-                    _mm_prefetch(&data[index(i + 1, i + 5)], _MM_HINT_T2);
-                    _mm_prefetch(&data_t[index(i + 1 + k, i + 4)], _MM_HINT_T2);
-                }
+            // Iterate over rows, computing the partial sums of the whole band (traced with the first diagonal)
+            {
+                const auto work = instrumentation.work();
+                compute_strips(k, band, 0, size - k, partial_sums.data());
+            }
 
-                // Use AVX to speed up the dot product calculation
-                long j = 0;
-                __m256d sum = _mm256_setzero_pd();
-                for (; j <= k - 4; j += 4) {
-                    const __m256d row = _mm256_loadu_pd(&data[index(i, i + j)]);
-                    const __m256d column = _mm256_loadu_pd(&data_t[index(i + k, i + 1 + j)]);
-                    sum = _mm256_add_pd(sum, _mm256_mul_pd(row, column));
+            // Iterate over the diagonals of the band and their batches of rows
+            for (long s = 0; s < band; ++s) {
+                if (s > 0) begin_diagonal(k + s);
+                for (long first = 0; first < size - k - s; first += tuning.chunk) {
+                    const auto work = instrumentation.work();
+                    compute_band_chunk(k, s, band, first, std::min(first + tuning.chunk, size - k - s),
+                                       partial_sums.data(), cbrt_mode);
                 }
+                instrumentation.end_diagonal(size - k - s, band_dot_product_length(k, s, band));
+                diagonal_done(k + s);
+            }
+        }
+        finish_sweep();
+    }
 
-                // Sum the elements of the AVX register
-                _mm256_store_pd(dot_product, sum);
-                dot_product[0] += dot_product[1] + dot_product[2] + dot_product[3];
+    /**
+     * \brief Change some elements of the main diagonal and recompute the elements of the upper diagonals that depend
+     * on them, in place: the elements (r, c) with r <= d <= c for a changed row d, diagonal by diagonal.
+     * The upper diagonals must have been computed; the other elements keep their values.
+     * \param update The changed elements of the main diagonal.
+     * \param cbrt_mode The accuracy of the cubic roots (default is exact).
+     * \throw std::invalid_argument if a row is out of the matrix.
+     */
+    void update_main_diagonal(const typename Matrix<T, Cell>::DiagonalUpdate& update,
+                              const CbrtMode cbrt_mode = CbrtMode::Exact) const {
+        const std::vector<long> changed = set_main_diagonal(update);
+        for (long k = 1; k <= diagonals && !changed.empty(); ++k) {
+            for (const auto& [first, last] : affected_chunks(changed, k)) {
+                compute_diagonal_chunk(k, first, last, cbrt_mode);
+            }
+        }
+    }
 
-                // Handle remaining elements
-                for (; j < k; ++j) {
-                    dot_product[0] += data[index(i, i + j)] * data_t[index(i + k, i + 1 + j) ];
-                }
+    /**
+     * \brief Evaluate an element lazily: compute only its dependency cone, the sub-triangle of the rows from row to
+     * column, diagonal by diagonal, skipping the elements computed by the previous evaluations and sweeps.
+     * \param row The row of the element.
+     * \param column The column of the element (column >= row).
+     * \param cbrt_mode The accuracy of the cubic roots (default is exact).
+     * \return The element, widened to double.
+     * \throw std::invalid_argument if the element is not in the upper triangle, or not in its band.
+     */
+    [[nodiscard]] double evaluate(const long row, const long column, const CbrtMode cbrt_mode = CbrtMode::Exact) const {
+        if (is_computed(row, column)) return this->get(row, column);
+
+        for (long k = 1; k <= column - row; ++k) {
+            for (const auto& [first, last] : missing_chunks(row, column, k)) {
+                compute_diagonal_chunk(k, first, last, cbrt_mode);
+            }
+        }
+        cone_computed(row, column);
+        return this->get(row, column);
+    }
+
+    /**
+     * \brief Set the upper diagonals of the matrix tile by tile.
+     * The upper triangle is split into square tiles (triangular on the main diagonal) that are computed in dependency
+     * order, column of tiles by column of tiles and bottom to top, so that the row and column segments of a tile are
+     * reused from cache. The result is the same as set_upper_diagonals() up to floating-point rounding.
+     * \param tile_size The number of rows and columns of a tile (default is 0, which means the one of the tuning
+     * profile).
+     * \throw std::invalid_argument if the matrix only holds a band of the triangle.
+     */
+    void set_upper_diagonals_tiled(long tile_size = 0) const {
+        require_whole_triangle();
+        if (tile_size <= 0) tile_size = tuning.tile_size;
+        const long tiles = (size + tile_size - 1) / tile_size;
+        std::vector<double> partial_sums(tile_size * tile_size);
 
-                // Store the result in the current diagonal
-                const double value = std::cbrt(dot_product[0]);
-                data[index(i, i + k)] = value;
-                data_t[index(i + k, i)] = value;
+        // Iterate over the columns of tiles, each one from the diagonal tile upwards
+        for (long tile_column = 0; tile_column < tiles; ++tile_column) {
+            for (long tile_row = tile_column; tile_row >= 0; --tile_row) {
+                compute_tile(tile_row, tile_column, tile_size, partial_sums.data());
             }
+            tile_column_done(tile_column, tile_size);
         }
+        mark_computed();
     }
 };
 
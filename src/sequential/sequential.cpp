@@ -3,16 +3,91 @@
 
 #include "seqmatrix.h"
 #include "../utils/timer.h"
-#include "../utils/csv.h"
+#include "../utils/benchmark.h"
+#include "../utils/checks.h"
 
 #include "sequential.h"
 
-void test_sequential() {
-    constexpr int dimensions[4]{1024, 2048, 4096, 8192};
-    std::vector<std::vector<double>> results;
-    const std::vector<std::string> headers{"Dimension", "Execution Time"};
+/**
+ * \brief Set the upper diagonals of a matrix, measuring the execution time.
+ * \param matrix The matrix.
+ * \param tile_size The number of rows and columns of a tile (0 means no tiling).
+ * \return The execution time.
+ */
+template <typename T>
+static double compute(const SeqMatrix<T>& matrix, const long tile_size) {
+    return measureExecutionTime([&matrix, tile_size]() {
+        if (tile_size > 0)
+            matrix.set_upper_diagonals_tiled(tile_size);
+        else
+            matrix.set_upper_diagonals();
+    });
+}
+
+/**
+ * \brief Check the stream of the diagonals of a new matrix (see check_stream()).
+ * \param dimension The size of the matrix.
+ * \param diagonals The number of upper diagonals of the matrix (0 means all of them).
+ * \return true if the stream matches the matrix, false otherwise.
+ */
+template <typename T>
+static bool check_stream(const long dimension, const long diagonals) {
+    SeqMatrix<T> matrix{dimension, {}, {}, diagonals};
+    return check_stream(matrix, [&matrix]() { matrix.set_upper_diagonals(); });
+}
+
+/**
+ * \brief Check the updates of the main diagonal of a new matrix (see check_update()).
+ * \param dimension The size of the matrix.
+ * \param diagonals The number of upper diagonals of the matrix (0 means all of them).
+ * \param precision The precision of the matrix.
+ * \return true if the updated matrix matches a new one, false otherwise.
+ */
+template <typename T>
+static bool check_update(const long dimension, const long diagonals, const Precision precision) {
+    return check_update<SeqMatrix<T>>(
+            dimension, diagonals, precision, [](const SeqMatrix<T>& matrix) { matrix.set_upper_diagonals(); },
+            [](const SeqMatrix<T>& matrix, const auto& update) { matrix.update_main_diagonal(update); });
+}
 
-    std::cout << "Processing sequentially..." << std::endl;
+/**
+ * \brief Check the lazy evaluations of the elements of a new matrix (see check_evaluate()).
+ * \param dimension The size of the matrix.
+ * \param diagonals The number of upper diagonals of the matrix (0 means all of them).
+ * \param precision The precision of the matrix.
+ * \return true if the evaluated elements match a swept matrix, false otherwise.
+ */
+template <typename T>
+static bool check_evaluate(const long dimension, const long diagonals, const Precision precision) {
+    return check_evaluate<SeqMatrix<T>>(
+            dimension, diagonals, precision, [](const SeqMatrix<T>& matrix) { matrix.set_upper_diagonals(); },
+            [](const SeqMatrix<T>& matrix, const long row, const long column) {
+                return matrix.evaluate(row, column);
+            });
+}
+
+bool test_sequential(const long tile_size, const Precision precision, const BenchmarkOptions& options) {
+    const std::string name = (tile_size > 0 ? "sequential_tiled_" + std::to_string(tile_size) : "sequential") +
+                             (precision == Precision::Float ? "_float" : "") + band_suffix(options);
+    BenchmarkReport report{name, "sequential", 1, options,
+                           {{"Tile Size", std::to_string(tile_size)}, {"Precision", to_string(precision)}}};
+    bool valid = true;
+
+    if (tile_size > 0 && options.diagonals > 0) {
+        std::cerr << "Invalid argument: the tiles compute the whole upper triangle, not a band." << std::endl;
+        return false;
+    }
+
+    if (tile_size > 0)
+        std::cout << "Processing sequentially in " << to_string(precision) << " with " << tile_size << "x"
+                  << tile_size << " tiles..." << std::endl;
+    else
+        std::cout << "Processing sequentially in " << to_string(precision) << "..." << std::endl;
+
+    // The cell of the recurrence is checked once, on a known instance (the tiles only split sums of products)
+    const bool chained = !options.check || check_chain_product<SeqMatrix<double, ChainProduct>>(
+            [](const SeqMatrix<double, ChainProduct>& matrix) { matrix.set_upper_diagonals(); });
+    valid = chained;
 
     indicators::ProgressBar bar {
             indicators::option::BarWidth{50},
@@ -25,18 +100,74 @@ void test_sequential() {
             indicators::option::ForegroundColor{indicators::Color::yellow},
             indicators::option::ShowElapsedTime{true},
             indicators::option::ShowRemainingTime{true},
-            indicators::option::MaxProgress{4}
+            indicators::option::MaxProgress{options.dimensions.size()}
     };
 
-    for (const int dimension : dimensions) {
+    for (const long dimension : options.dimensions) {
         bar.set_option(indicators::option::PostfixText{"Processed dimension " + std::to_string(dimension)});
-        SeqMatrix matrix{dimension};
-        const double executionTime = measureExecutionTime([&matrix]() {
-            matrix.set_upper_diagonals();
-        });
-        results.emplace_back(std::vector{static_cast<double>(dimension), executionTime});
+        std::vector<BenchmarkReport::Field> fields;
+        std::vector<double> times;
+        double checksum;
+        bool saved = true;
+
+        const SeqMatrix matrix{dimension, {}, {}, options.diagonals};
+        if (precision == Precision::Float) {
+            const SeqMatrix<float> float_matrix{dimension, {}, {}, options.diagonals};
+            times = repeat(options, [&float_matrix, tile_size]() { return compute(float_matrix, tile_size); });
+            checksum = float_matrix.checksum();
+            write_trace(float_matrix.get_instrumentation(), name, dimension);
+            if (options.save) saved = check_save(float_matrix, name, dimension);
+
+            // The double matrix is the reference for the accuracy of the float one
+            compute(matrix, tile_size);
+            fields.emplace_back("Max Relative Error", toCSVScientificField(float_matrix.max_relative_error(matrix)));
+        } else {
+            times = repeat(options, [&matrix, tile_size]() { return compute(matrix, tile_size); });
+            checksum = matrix.checksum();
+            write_trace(matrix.get_instrumentation(), name, dimension);
+            if (options.save) saved = check_save(matrix, name, dimension);
+        }
+
+        if (options.check) {
+            // The reference has the same band
+            const SeqMatrix reference{dimension, {}, {}, options.diagonals};
+            reference.set_upper_diagonals();
+            const bool matches = check_checksum(dimension, checksum, reference.checksum(), precision);
+            fields.emplace_back("Checksum Check", matches ? "ok" : "mismatch");
+            fields.emplace_back("Chain Product Check", chained ? "ok" : "mismatch");
+            valid = valid && matches;
+
+            const bool updated = precision == Precision::Float
+                                 ? check_update<float>(dimension, options.diagonals, precision)
+                                 : check_update<double>(dimension, options.diagonals, precision);
+            fields.emplace_back("Update Check", updated ? "ok" : "mismatch");
+            valid = valid && updated;
+
+            const bool evaluated = precision == Precision::Float
+                                   ? check_evaluate<float>(dimension, options.diagonals, precision)
+                                   : check_evaluate<double>(dimension, options.diagonals, precision);
+            fields.emplace_back("Evaluate Check", evaluated ? "ok" : "mismatch");
+            valid = valid && evaluated;
+
+            // Only the sweeps by diagonals stream
+            if (tile_size <= 0) {
+                const bool streamed = precision == Precision::Float
+                                      ? check_stream<float>(dimension, options.diagonals)
+                                      : check_stream<double>(dimension, options.diagonals);
+                fields.emplace_back("Stream Check", streamed ? "ok" : "mismatch");
+                valid = valid && streamed;
+            }
+        }
+
+        if (options.save) {
+            fields.emplace_back("Save Check", saved ? "ok" : "mismatch");
+            valid = valid && saved;
+        }
+
+        report.add(dimension, times, checksum, std::move(fields));
         bar.tick();
     }
 
-    writeCSV<double>("sequential.csv", headers, results);
+    report.write();
+    return valid;
 }
\ No newline at end of file
@@ -1,6 +1,8 @@
 #ifndef SPM_SEQUENTIAL_H
 #define SPM_SEQUENTIAL_H
 
-void test_sequential();
+#include "../utils/benchmark.h"
+
+bool test_sequential(long, Precision, const BenchmarkOptions&);
 
 #endif //SPM_SEQUENTIAL_H
\ No newline at end of file
@@ -0,0 +1,121 @@
+#ifndef SPM_THREADMATRIX_H
+#define SPM_THREADMATRIX_H
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "../utils/matrix.h"
+#include "work_stealing_pool.h"
+
+/**
+ * \brief A class to represent an upper triangular matrix with parallel computation of the upper diagonals on a pool
+ * of standard threads with work stealing (see WorkStealingPool), without FastFlow.
+ * \tparam T The type of the stored elements (double or float).
+ * \tparam Cell The recurrence of the upper diagonals (see Matrix).
+ */
+template <typename T = double, typename Cell = CbrtDotProduct>
+class ThreadMatrix final : public Matrix<T, Cell> {
+
+protected:
+
+    using Matrix<T, Cell>::size;
+    using Matrix<T, Cell>::diagonals;
+    using Matrix<T, Cell>::start_sweep;
+    using Matrix<T, Cell>::begin_diagonal;
+    using Matrix<T, Cell>::diagonal_done;
+    using Matrix<T, Cell>::finish_sweep;
+    using Matrix<T, Cell>::first_band_diagonal;
+    using Matrix<T, Cell>::compute_diagonal_chunk;
+    using Matrix<T, Cell>::compute_strips;
+    using Matrix<T, Cell>::compute_band_chunk;
+    using Matrix<T, Cell>::instrumentation;
+    using Matrix<T, Cell>::tuning;
+
+public:
+
+    /**
+     * \brief Constructor to initialize the matrix with a given size.
+     * \param size The size of the matrix (number of rows and columns).
+     */
+    explicit ThreadMatrix(const long size) : Matrix<T, Cell>(size) {}
+
+    /**
+     * \brief Constructor to initialize the matrix with a given main diagonal.
+     * \param size The size of the matrix (number of rows and columns).
+     * \param diagonal The main diagonal, size elements (empty for the default one).
+     * \param cell The cell of the recurrence (default is a default-constructed one).
+     * \param diagonals The number of upper diagonals stored and computed (default is 0, which means all of them).
+     */
+    ThreadMatrix(const long size, const std::vector<double>& diagonal, const Cell& cell = {},
+                 const long diagonals = 0) :
+    Matrix<T, Cell>(size, diagonal, cell, diagonals) {}
+
+    /**
+     * \brief Set the upper diagonals of the matrix in parallel, as FFMatrix::set_upper_diagonals().
+     * The rows of each diagonal are split in about four chunks per worker, so that the workers that finish early
+     * steal the chunks left to the others; the diagonals with a single chunk are computed by the calling thread.
+     * \param maxnw The number of workers (default is 0, which means the one of the tuning profile or all the cores).
+     * \param register_blocking Whether to compute the diagonals in bands with the strip kernel (default is true).
+     * \param cbrt_mode The accuracy of the cubic roots (default is exact).
+     */
+    void set_upper_diagonals(const long maxnw = 0, const bool register_blocking = true,
+                             const CbrtMode cbrt_mode = CbrtMode::Exact) const {
+        WorkStealingPool pool{worker_count(maxnw)};
+        const long first_band = first_band_diagonal(register_blocking);
+        const auto chunk = [&](const long rows) {
+            return std::clamp(rows / (4 * pool.workers()), 1L, tuning.chunk);
+        };
+        start_sweep();
+
+        // Iterate over upper diagonals
+        for (long k = 1; k < first_band; ++k) {
+            begin_diagonal(k);
+            pool.parallel_for(0, size - k, chunk(size - k), [&](const long first, const long last) {
+                const auto work = instrumentation.work();
+                compute_diagonal_chunk(k, first, last, cbrt_mode);
+            });
+            instrumentation.end_diagonal(size - k, k);
+            diagonal_done(k);
+        }
+
+        // Iterate over the bands of upper diagonals
+        std::vector<double> partial_sums(std::max(size - first_band, 0L) * strip_width);
+        for (long k = first_band; k <= diagonals; k += strip_width) {
+            const long band = std::min(strip_width, diagonals + 1 - k);
+            begin_diagonal(k);
+
+            // The partial sums of the band (traced with its first diagonal), then its diagonals one by one
+            pool.parallel_for(0, size - k, chunk(size - k), [&](const long first, const long last) {
+                const auto work = instrumentation.work();
+                compute_strips(k, band, first, last, partial_sums.data());
+            });
+            for (long s = 0; s < band; ++s) {
+                if (s > 0) begin_diagonal(k + s);
+                pool.parallel_for(0, size - k - s, chunk(size - k - s), [&](const long first, const long last) {
+                    const auto work = instrumentation.work();
+                    compute_band_chunk(k, s, band, first, last, partial_sums.data(), cbrt_mode);
+                });
+                instrumentation.end_diagonal(size - k - s, band_dot_product_length(k, s, band));
+                diagonal_done(k + s);
+            }
+        }
+        finish_sweep();
+    }
+
+private:
+
+    /**
+     * \brief Get the number of workers of a sweep.
+     * \param maxnw The number of workers asked for, 0 for the one of the tuning profile.
+     * \return The number of workers, all the cores if neither is set.
+     */
+    [[nodiscard]] long worker_count(const long maxnw) const {
+        if (maxnw > 0) return maxnw;
+        if (tuning.workers > 0) return tuning.workers;
+        return std::max(1L, static_cast<long>(std::thread::hardware_concurrency()));
+    }
+
+};
+
+#endif //SPM_THREADMATRIX_H
\ No newline at end of file
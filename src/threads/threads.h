@@ -0,0 +1,8 @@
+#ifndef SPM_THREADS_H
+#define SPM_THREADS_H
+
+#include "../utils/benchmark.h"
+
+bool test_threads(long, Precision, const BenchmarkOptions&);
+
+#endif //SPM_THREADS_H
\ No newline at end of file
@@ -0,0 +1,190 @@
+#ifndef SPM_WORK_STEALING_POOL_H
+#define SPM_WORK_STEALING_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * \brief A pool of threads that run parallel loops over chunks of a range, balanced by work stealing.
+ * Each loop deals contiguous runs of chunks to the queues of the workers. A worker takes the chunks of its own queue
+ * from the front, in order, and when it is empty it steals from the back of the others, so the chunks stolen are the
+ * ones the victim would have reached last. The calling thread is the first worker, the others wait for the next loop
+ * spinning for a while, then sleeping.
+ */
+class WorkStealingPool {
+
+public:
+
+    /**
+     * \brief The body of a loop, called with the first index and the index past the last one of each chunk.
+     */
+    using Body = std::function<void(long, long)>;
+
+    /**
+     * \brief Constructor to start the threads of the pool.
+     * \param nw The number of workers, including the calling thread.
+     */
+    explicit WorkStealingPool(const long nw) : queues(std::max(nw, 1L)) {
+        for (long w = 1; w < workers(); ++w) {
+            threads.emplace_back([this, w]() { work(w); });
+        }
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    /**
+     * \brief Destructor to stop and join the threads.
+     */
+    ~WorkStealingPool() {
+        stopping.store(true, std::memory_order_relaxed);
+        generation.fetch_add(1, std::memory_order_release);
+        generation.notify_all();
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    }
+
+    /**
+     * \brief Get the number of workers.
+     * \return The number of workers, including the calling thread.
+     */
+    [[nodiscard]] long workers() const {
+        return static_cast<long>(queues.size());
+    }
+
+    /**
+     * \brief Run a loop over a range in chunks, and wait for all of them.
+     * A loop with a single chunk runs on the calling thread without waking up the workers.
+     * \param first The first index.
+     * \param last The index past the last one.
+     * \param chunk The number of indices of a chunk.
+     * \param body The body of the loop.
+     */
+    void parallel_for(const long first, const long last, const long chunk, const Body& body) {
+        const long chunks = (last - first + chunk - 1) / chunk;
+        if (chunks <= 0) return;
+        if (chunks == 1 || workers() == 1) {
+            for (long begin = first; begin < last; begin += chunk) {
+                body(begin, std::min(begin + chunk, last));
+            }
+            return;
+        }
+
+        // Deal contiguous runs of chunks to the queues, then wake up the workers
+        current = Loop{&body, first, last, chunk};
+        pending.store(chunks, std::memory_order_relaxed);
+        const long nw = workers();
+        for (long w = 0; w < nw; ++w) {
+            Queue& queue = queues[w];
+            const std::lock_guard lock{queue.mutex};
+            queue.head = chunks * w / nw;
+            queue.tail = chunks * (w + 1) / nw;
+        }
+        generation.fetch_add(1, std::memory_order_release);
+        generation.notify_all();
+
+        run(0);
+        while (pending.load(std::memory_order_acquire) > 0) {
+            std::this_thread::yield();
+        }
+    }
+
+private:
+
+    /**
+     * \brief The queue of the chunks of a worker, as a range of chunk indices of the current loop.
+     */
+    struct alignas(64) Queue {
+        std::mutex mutex; ///< The lock of the range.
+        long head = 0; ///< The next chunk to take, from the front.
+        long tail = 0; ///< The chunk past the last one, stolen from the back.
+    };
+
+    /**
+     * \brief The loop being run.
+     */
+    struct Loop {
+        const Body* body; ///< The body of the loop.
+        long first; ///< The first index.
+        long last; ///< The index past the last one.
+        long chunk; ///< The number of indices of a chunk.
+    };
+
+    static constexpr int spin_iterations = 1 << 14; ///< The checks of a new loop before sleeping.
+
+    std::vector<Queue> queues; ///< The queues of the workers.
+    std::vector<std::thread> threads; ///< The threads of the workers after the first one.
+    Loop current{}; ///< The loop being run, set before the chunks are dealt.
+    std::atomic<long> pending{0}; ///< The chunks of the loop not completed yet.
+    std::atomic<unsigned long> generation{0}; ///< The number of loops started, to wake up the workers.
+    std::atomic<bool> stopping{false}; ///< Whether the pool is being destroyed.
+
+    /**
+     * \brief The loop of a worker thread: wait for a new loop, run its chunks, repeat until the pool is destroyed.
+     * \param w The index of the worker.
+     */
+    void work(const long w) {
+        unsigned long seen = 0;
+        while (true) {
+            for (int spin = 0; spin < spin_iterations && generation.load(std::memory_order_acquire) == seen; ++spin) {
+                std::this_thread::yield();
+            }
+            generation.wait(seen, std::memory_order_acquire);
+            seen = generation.load(std::memory_order_acquire);
+            if (stopping.load(std::memory_order_relaxed)) return;
+            run(w);
+        }
+    }
+
+    /**
+     * \brief Run the chunks of the queue of a worker, then steal from the others until all the queues are empty.
+     * \param w The index of the worker.
+     */
+    void run(const long w) {
+        const long nw = workers();
+        for (long victim = w, failures = 0; failures < nw; victim = (victim + 1) % nw) {
+            const long chunk = victim == w ? take(queues[w]) : steal(queues[victim]);
+            if (chunk < 0) {
+                ++failures;
+                continue;
+            }
+            failures = 0;
+            victim = w - 1 < 0 ? nw - 1 : w - 1;
+
+            const Loop loop = current;
+            const long begin = loop.first + chunk * loop.chunk;
+            (*loop.body)(begin, std::min(begin + loop.chunk, loop.last));
+            pending.fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+    /**
+     * \brief Take the next chunk from the front of the own queue.
+     * \param queue The queue.
+     * \return The chunk, or -1 if the queue is empty.
+     */
+    static long take(Queue& queue) {
+        const std::lock_guard lock{queue.mutex};
+        return queue.head < queue.tail ? queue.head++ : -1;
+    }
+
+    /**
+     * \brief Steal the last chunk from the back of the queue of another worker.
+     * \param queue The queue.
+     * \return The chunk, or -1 if the queue is empty.
+     */
+    static long steal(Queue& queue) {
+        const std::lock_guard lock{queue.mutex};
+        return queue.head < queue.tail ? --queue.tail : -1;
+    }
+
+};
+
+#endif //SPM_WORK_STEALING_POOL_H
\ No newline at end of file
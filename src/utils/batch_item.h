@@ -0,0 +1,62 @@
+#ifndef SPM_BATCH_ITEM_H
+#define SPM_BATCH_ITEM_H
+
+#include <algorithm>
+#include <cstddef>
+#include <numeric>
+#include <vector>
+
+/**
+ * \brief A matrix of a batch of independent matrices.
+ */
+struct BatchItem {
+    long size; ///< The size of the matrix (number of rows and columns).
+    std::vector<double> diagonal; ///< The main diagonal, empty for the default one (1/size, 2/size, ..., size/size).
+    long diagonals = 0; ///< The number of upper diagonals stored and computed (0 means all of them, see Matrix).
+};
+
+/**
+ * \brief Make a batch of matrices with the default main diagonal, cycling through some sizes.
+ * \param sizes The sizes of the matrices.
+ * \param count The number of matrices.
+ * \param diagonals The number of upper diagonals of the matrices (default is 0, which means all of them).
+ * \return The batch.
+ */
+inline std::vector<BatchItem> make_batch(const std::vector<long>& sizes, const long count, const long diagonals = 0) {
+    std::vector<BatchItem> items;
+    items.reserve(count);
+    for (long i = 0; i < count; ++i) {
+        items.push_back(BatchItem{sizes[i % sizes.size()], {}, diagonals});
+    }
+    return items;
+}
+
+/**
+ * \brief Get the cost of computing a matrix, proportional to the multiply-adds of its dot products: k for each of
+ * the size - k elements of each upper diagonal k.
+ * \param size The size of the matrix.
+ * \param diagonals The number of upper diagonals of the matrix (default is 0, which means all of them).
+ * \return The cost.
+ */
+inline double batch_cost(const long size, const long diagonals = 0) {
+    const auto n = static_cast<double>(size);
+    const auto k = static_cast<double>(diagonals > 0 && diagonals < size - 1 ? diagonals : std::max(size - 1, 0L));
+    return n * k * (k + 1.0) / 2.0 - k * (k + 1.0) * (2.0 * k + 1.0) / 6.0;
+}
+
+/**
+ * \brief Get the order in which to schedule the matrices of a batch: the most expensive ones first, so that the
+ * cheap ones fill the gaps at the end.
+ * \param items The batch.
+ * \return The indices of the matrices in scheduling order.
+ */
+inline std::vector<std::size_t> batch_order(const std::vector<BatchItem>& items) {
+    std::vector<std::size_t> order(items.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&items](const std::size_t a, const std::size_t b) {
+        return items[a].size > items[b].size;
+    });
+    return order;
+}
+
+#endif //SPM_BATCH_ITEM_H
\ No newline at end of file
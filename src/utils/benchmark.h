@@ -0,0 +1,473 @@
+#ifndef SPM_BENCHMARK_H
+#define SPM_BENCHMARK_H
+
+#include <unistd.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "cli.h"
+#include "buffer_pool.h"
+#include "csv.h"
+#include "instrumentation.h"
+#include "kernels.h"
+#include "precision.h"
+#include "tuning.h"
+
+#ifndef SPM_CXX_FLAGS
+#define SPM_CXX_FLAGS "" ///< The compiler flags of the build, defined by CMake.
+#endif
+
+/**
+ * \brief The options of a benchmark, shared by all the drivers.
+ */
+struct BenchmarkOptions {
+    std::vector<long> dimensions{1024, 2048, 4096, 8192}; ///< The sizes of the matrices.
+    long repetitions = 1; ///< The number of timed runs of each dimension.
+    long warmup = 0; ///< The number of untimed runs of each dimension before the timed ones.
+    long diagonals = 0; ///< The number of upper diagonals of the matrices (0 means all of them, see Matrix).
+    bool check = false; ///< Whether to compare the checksums with the ones of the sequential backend.
+    bool save = false; ///< Whether to save the matrices in the results directory and verify the files.
+};
+
+/**
+ * \brief The usage of the options of a benchmark.
+ */
+inline const std::string benchmark_usage = "[--dimensions=<n>[,<n>...]] [--repetitions=<n>] [--warmup=<n>] "
+                                           "[--diagonals=<K>] [--check] [--save]";
+
+/**
+ * \brief Parse a comma separated list of positive integers.
+ * On failure, an error message is printed to the standard error.
+ * \param list The list to parse.
+ * \param values The parsed values.
+ * \return true if the list is valid, false otherwise.
+ */
+inline bool parse_list(const std::string& list, std::vector<long>& values) {
+    values.clear();
+    std::istringstream stream{list};
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        long value;
+        if (!parseLong(item.c_str(), value)) return false;
+        if (value <= 0) {
+            std::cerr << "Invalid argument: " << item << " is not positive." << std::endl;
+            return false;
+        }
+        values.push_back(value);
+    }
+    if (values.empty()) {
+        std::cerr << "Invalid argument: the list is empty." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * \brief Parse the options of a benchmark and remove them from the command line arguments,
+ * so that the positional arguments of the driver keep their positions.
+ * \param argc The number of arguments, updated to the number of remaining arguments.
+ * \param argv The arguments, compacted to the remaining arguments.
+ * \param options The parsed options.
+ * \return true if the options are valid, false otherwise.
+ */
+inline bool parse_benchmark_options(int& argc, char* argv[], BenchmarkOptions& options) {
+    int remaining = 1;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg{argv[i]};
+        bool valid = true;
+        if (arg.rfind("--dimensions=", 0) == 0) {
+            valid = parse_list(arg.substr(13), options.dimensions);
+        } else if (arg.rfind("--repetitions=", 0) == 0) {
+            valid = parseLong(argv[i] + 14, options.repetitions);
+            if (valid && options.repetitions == 0) {
+                std::cerr << "Invalid argument: at least one repetition is needed." << std::endl;
+                valid = false;
+            }
+        } else if (arg.rfind("--warmup=", 0) == 0) {
+            valid = parseLong(argv[i] + 9, options.warmup);
+        } else if (arg.rfind("--diagonals=", 0) == 0) {
+            valid = parseLong(argv[i] + 12, options.diagonals);
+        } else if (arg == "--check") {
+            options.check = true;
+        } else if (arg == "--save") {
+            options.save = true;
+        } else {
+            argv[remaining++] = argv[i];
+        }
+        if (!valid) return false;
+    }
+    if (options.save && options.diagonals > 0) {
+        std::cerr << "Invalid argument: only the whole upper triangle can be saved, not a band." << std::endl;
+        return false;
+    }
+    argc = remaining;
+    return true;
+}
+
+/**
+ * \brief Get the suffix of the names of the results of a benchmark for the band of its matrices.
+ * \param options The options of the benchmark.
+ * \return _band_<K> for a band of K diagonals, empty for the whole triangle.
+ */
+inline std::string band_suffix(const BenchmarkOptions& options) {
+    return options.diagonals > 0 ? "_band_" + std::to_string(options.diagonals) : "";
+}
+
+/**
+ * \brief The statistics of the execution times of a configuration.
+ */
+struct Statistics {
+    double min; ///< The minimum execution time.
+    double median; ///< The median execution time.
+    double mean; ///< The mean execution time.
+    double stddev; ///< The sample standard deviation of the execution times (0 with a single run).
+};
+
+/**
+ * \brief Compute the statistics of some execution times.
+ * \param times The execution times (at least one).
+ * \return The statistics.
+ */
+inline Statistics summarize(std::vector<double> times) {
+    std::sort(times.begin(), times.end());
+    const std::size_t count = times.size();
+    const double median = count % 2 == 1 ? times[count / 2] : (times[count / 2 - 1] + times[count / 2]) / 2.0;
+    const double mean = std::accumulate(times.begin(), times.end(), 0.0) / static_cast<double>(count);
+
+    double squares = 0.0;
+    for (const double time : times) {
+        squares += (time - mean) * (time - mean);
+    }
+    const double stddev = count > 1 ? std::sqrt(squares / static_cast<double>(count - 1)) : 0.0;
+    return Statistics{times.front(), median, mean, stddev};
+}
+
+/**
+ * \brief Run a configuration the number of times set by the options.
+ * \tparam Run The type of the function that runs the configuration once.
+ * \param options The options of the benchmark.
+ * \param run The function that runs the configuration once and returns its execution time.
+ * \return The execution times of the timed runs (the warm-up runs are discarded).
+ */
+template <typename Run>
+std::vector<double> repeat(const BenchmarkOptions& options, Run&& run) {
+    for (long i = 0; i < options.warmup; ++i) {
+        run();
+    }
+    std::vector<double> times;
+    for (long i = 0; i < options.repetitions; ++i) {
+        times.push_back(run());
+    }
+    return times;
+}
+
+/**
+ * \brief Get the tolerance of the checksums of the backends, relative to the one of the sequential backend.
+ * The backends add the terms of the dot products in different orders, and float rounds each element on store.
+ * \param precision The precision of the checked matrix.
+ * \return The maximum relative difference of the checksums.
+ */
+inline double checksum_tolerance(const Precision precision) {
+    return precision == Precision::Float ? 1e-5 : 1e-9;
+}
+
+/**
+ * \brief Compare the checksum of a matrix with the one of the sequential backend, printing an error if they differ.
+ * \param dimension The size of the matrix.
+ * \param checksum The checksum of the matrix.
+ * \param reference The checksum of the sequential backend in double precision.
+ * \param precision The precision of the matrix.
+ * \return true if the checksums match, false otherwise.
+ */
+inline bool check_checksum(const long dimension, const double checksum, const double reference,
+                           const Precision precision) {
+    if (std::abs(checksum - reference) <= checksum_tolerance(precision) * std::abs(reference)) return true;
+
+    std::cerr << "Checksum mismatch for dimension " << dimension << ": " << std::setprecision(17) << checksum
+              << " instead of " << reference << std::endl;
+    return false;
+}
+
+/**
+ * \brief Write the trace of the last timed run of a dimension in the results directory, if it was recorded.
+ * \param instrumentation The trace of the run.
+ * \param name The name of the benchmark.
+ * \param dimension The size of the matrix.
+ * \param suffix The suffix of the file name, to tell apart the traces of the processes (default is none).
+ */
+inline void write_trace(const Instrumentation& instrumentation, const std::string& name, const long dimension,
+                        const std::string& suffix = "") {
+    if (instrumentation.empty()) return;
+
+    instrumentation.write(name + "_trace_" + std::to_string(dimension) + suffix + ".csv");
+}
+
+/**
+ * \brief The results of a benchmark, written as CSV and JSON files in the results directory.
+ * The CSV file keeps the median execution time in the "Execution Time" column, so that the scripts read it as
+ * before; the JSON file also records the host, the number of threads, the compiler flags and all the runs.
+ * Each run is kept in its own files, named after the host and the start time of the run, and <name>.csv is a copy
+ * of the last run for the scripts.
+ */
+class BenchmarkReport {
+
+public:
+
+    /**
+     * \brief A field of a row, as a name and a formatted value.
+     */
+    using Field = std::pair<std::string, std::string>;
+
+    /**
+     * \brief Constructor.
+     * \param name The name of the files, without extension.
+     * \param backend The name of the backend.
+     * \param threads The total number of threads (or processes) that compute the matrix.
+     * \param options The options of the benchmark.
+     * \param parameters The parameters of the backend, recorded in the JSON file.
+     */
+    BenchmarkReport(std::string name, std::string backend, const long threads, const BenchmarkOptions& options,
+                    std::vector<Field> parameters) :
+    name{std::move(name)},
+    backend{std::move(backend)},
+    threads{threads},
+    options{options},
+    parameters{std::move(parameters)},
+    started{timestamp()}
+    {}
+
+    /**
+     * \brief Add the results of a dimension.
+     * \param dimension The size of the matrix.
+     * \param times The execution times of the timed runs.
+     * \param checksum The checksum of the matrix.
+     * \param fields The other fields of the row (the same names for all the rows).
+     */
+    void add(const long dimension, const std::vector<double>& times, const double checksum,
+             std::vector<Field> fields = {}) {
+        rows.push_back(Row{dimension, false, times, summarize(times), checksum, std::move(fields)});
+    }
+
+    /**
+     * \brief Add the results of a batch, in a row with a "Matrices" column in place of the "Dimension" one.
+     * The sizes of the matrices of the batch are a parameter of the report.
+     * \param matrices The number of matrices of the batch.
+     * \param times The execution times of the timed runs.
+     * \param checksum The sum of the checksums of the matrices.
+     * \param fields The other fields of the row (the same names for all the rows).
+     */
+    void add_batch(const long matrices, const std::vector<double>& times, const double checksum,
+                   std::vector<Field> fields = {}) {
+        rows.push_back(Row{matrices, true, times, summarize(times), checksum, std::move(fields)});
+    }
+
+    /**
+     * \brief Write the CSV and JSON files of the run, and the copy of the CSV file for the scripts.
+     */
+    void write() const {
+        const std::string run = run_name();
+        write_csv(run);
+        write_json(run);
+        write_csv(name);
+    }
+
+private:
+
+    /**
+     * \brief The results of a dimension or of a batch.
+     */
+    struct Row {
+        long dimension; ///< The size of the matrix, or the number of matrices of a batch.
+        bool batch; ///< Whether the row is a batch.
+        std::vector<double> times; ///< The execution times of the timed runs.
+        Statistics statistics; ///< The statistics of the execution times.
+        double checksum; ///< The checksum of the matrix.
+        std::vector<Field> fields; ///< The other fields of the row.
+    };
+
+    const std::string name; ///< The name of the files, without extension.
+    const std::string backend; ///< The name of the backend.
+    const long threads; ///< The total number of threads (or processes).
+    const BenchmarkOptions options; ///< The options of the benchmark.
+    const std::vector<Field> parameters; ///< The parameters of the backend.
+    const std::string started; ///< The start time of the run.
+    std::vector<Row> rows; ///< The results of each dimension.
+
+    /**
+     * \brief Get the name of the files of the run, the name of the benchmark followed by the host and the start
+     * time, with a counter if another run on the same host started in the same second.
+     * \return The name of the files, without extension.
+     */
+    [[nodiscard]] std::string run_name() const {
+        const std::filesystem::path results = std::filesystem::current_path() / "results";
+        const std::string base = name + "_" + host() + "_" + started;
+        std::string run = base;
+        for (int i = 1; std::filesystem::exists(results / (run + ".json")); ++i) {
+            run = base + "_" + std::to_string(i);
+        }
+        return run;
+    }
+
+    /**
+     * \brief Write the CSV file, one row per dimension or batch.
+     * \param file_name The name of the file, without extension.
+     */
+    void write_csv(const std::string& file_name) const {
+        const bool batch = !rows.empty() && rows.front().batch;
+        std::vector<std::string> headers{batch ? "Matrices" : "Dimension", "Execution Time", "Min", "Mean", "Stddev",
+                                         "Repetitions", "Checksum"};
+        if (!rows.empty()) {
+            for (const auto& [field, value] : rows.front().fields) {
+                headers.push_back(field);
+            }
+        }
+
+        std::vector<std::vector<std::string>> data;
+        for (const auto& row : rows) {
+            std::vector<std::string> values{std::to_string(row.dimension), toCSVField(row.statistics.median),
+                                            toCSVField(row.statistics.min), toCSVField(row.statistics.mean),
+                                            toCSVField(row.statistics.stddev), std::to_string(row.times.size()),
+                                            toCSVField(row.checksum)};
+            for (const auto& [field, value] : row.fields) {
+                values.push_back(value);
+            }
+            data.push_back(std::move(values));
+        }
+        writeCSV<std::string>(file_name + ".csv", headers, data);
+    }
+
+    /**
+     * \brief Write the JSON file, with the environment of the benchmark and all the runs.
+     * \param file_name The name of the file, without extension.
+     */
+    void write_json(const std::string& file_name) const {
+        const std::filesystem::path path = std::filesystem::current_path() / "results" / (file_name + ".json");
+        std::ofstream file(path);
+        if (!file.is_open()) {
+            throw std::runtime_error("Could not open file");
+        }
+
+        file << std::setprecision(17);
+        file << "{\n";
+        file << "  \"backend\": " << quote(backend) << ",\n";
+        file << "  \"host\": " << quote(host()) << ",\n";
+        file << "  \"started\": " << quote(started) << ",\n";
+        file << "  \"threads\": " << threads << ",\n";
+        file << "  \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n";
+        file << "  \"compiler\": " << quote(compiler()) << ",\n";
+        file << "  \"flags\": " << quote(SPM_CXX_FLAGS) << ",\n";
+        file << "  \"kernel\": " << quote(kernel_isa) << ",\n";
+        file << "  \"huge_pages\": " << quote(to_string(BufferPool::get().huge_pages())) << ",\n";
+        file << "  \"repetitions\": " << options.repetitions << ",\n";
+        file << "  \"warmup\": " << options.warmup << ",\n";
+        file << "  \"diagonals\": " << options.diagonals << ",\n";
+        file << "  \"parameters\": {";
+        for (std::size_t i = 0; i < parameters.size(); ++i) {
+            file << (i > 0 ? ", " : "") << quote(parameters[i].first) << ": " << value(parameters[i].second);
+        }
+        file << "},\n";
+        file << "  \"results\": [";
+        for (std::size_t r = 0; r < rows.size(); ++r) {
+            const Row& row = rows[r];
+            file << (r > 0 ? "," : "") << "\n    {" << quote(row.batch ? "matrices" : "dimension") << ": "
+                 << row.dimension
+                 << ", \"min\": " << row.statistics.min << ", \"median\": " << row.statistics.median
+                 << ", \"mean\": " << row.statistics.mean << ", \"stddev\": " << row.statistics.stddev
+                 << ", \"checksum\": " << row.checksum;
+            for (const auto& [field, value] : row.fields) {
+                file << ", " << quote(field) << ": " << this->value(value);
+            }
+            file << ", \"times\": [";
+            for (std::size_t i = 0; i < row.times.size(); ++i) {
+                file << (i > 0 ? ", " : "") << row.times[i];
+            }
+            file << "]}";
+        }
+        file << "\n  ]\n}\n";
+    }
+
+    /**
+     * \brief Quote a string for JSON.
+     * \param text The string.
+     * \return The quoted string, with the quotes, the backslashes and the control characters escaped.
+     */
+    static std::string quote(const std::string& text) {
+        std::ostringstream oss;
+        oss << '"';
+        for (const char c : text) {
+            if (c == '"' || c == '\\') {
+                oss << '\\' << c;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                oss << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec;
+            } else {
+                oss << c;
+            }
+        }
+        oss << '"';
+        return oss.str();
+    }
+
+    /**
+     * \brief Format a field for JSON.
+     * \param text The formatted value of the field.
+     * \return The value as a JSON number if it is one, as a JSON string otherwise.
+     */
+    static std::string value(const std::string& text) {
+        char* end = nullptr;
+        const double number = std::strtod(text.c_str(), &end);
+        return !text.empty() && *end == '\0' && std::isfinite(number) ? text : quote(text);
+    }
+
+    /**
+     * \brief Get the name of the host.
+     * \return The name of the host.
+     */
+    static std::string host() {
+        char buffer[256] = {};
+        gethostname(buffer, sizeof(buffer) - 1);
+        return buffer;
+    }
+
+    /**
+     * \brief Get the current local time.
+     * \return The time as YYYYMMDDTHHMMSS, so that the names of the files sort by time.
+     */
+    static std::string timestamp() {
+        const std::time_t now = std::time(nullptr);
+        std::tm local{};
+        localtime_r(&now, &local);
+        char buffer[32] = {};
+        std::strftime(buffer, sizeof(buffer), "%Y%m%dT%H%M%S", &local);
+        return buffer;
+    }
+
+    /**
+     * \brief Get the compiler of the build.
+     * \return The name and version of the compiler.
+     */
+    static std::string compiler() {
+#if defined(__clang__)
+        return std::string{"Clang "} + __clang_version__;
+#elif defined(__GNUC__)
+        return std::string{"GCC "} + __VERSION__;
+#else
+        return "unknown";
+#endif
+    }
+
+};
+
+#endif //SPM_BENCHMARK_H
\ No newline at end of file
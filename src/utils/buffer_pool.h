@@ -0,0 +1,219 @@
+#ifndef SPM_BUFFER_POOL_H
+#define SPM_BUFFER_POOL_H
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cstddef>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+
+/**
+ * \brief The pages that back the buffers of the pool, set with the SPM_HUGE_PAGES environment variable.
+ */
+enum class HugePages {
+    Off, ///< Regular pages ("off").
+    Transparent, ///< Transparent huge pages, hinted with madvise (unset, empty or "transparent").
+    Huge2M, ///< 2 MiB pages of hugetlbfs ("2M"), falling back to transparent huge pages if none are reserved.
+    Huge1G ///< 1 GiB pages of hugetlbfs ("1G"), falling back to transparent huge pages if none are reserved.
+};
+
+/**
+ * \brief Get the name of a huge pages setting.
+ * \param pages The setting.
+ * \return The name of the setting.
+ */
+inline std::string to_string(const HugePages pages) {
+    switch (pages) {
+        case HugePages::Off: return "off";
+        case HugePages::Huge2M: return "2M";
+        case HugePages::Huge1G: return "1G";
+        default: return "transparent";
+    }
+}
+
+/**
+ * \brief A process-wide pool of large page-aligned buffers, backed by huge pages and pre-faulted on allocation,
+ * so that constructing a matrix does not page-fault its triangles inside the timed computation.
+ * A released buffer is kept and reused by the next request of the same size or smaller. When no free buffer is
+ * large enough, the free ones are unmapped before mapping a new one, so the pool never holds more memory than the
+ * buffers in use plus the ones that would be reused.
+ */
+class BufferPool {
+
+public:
+
+    /**
+     * \brief Get the pool of the process.
+     * \return The pool.
+     */
+    static BufferPool& get() {
+        static BufferPool pool;
+        return pool;
+    }
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    /**
+     * \brief Destructor to unmap all the buffers.
+     */
+    ~BufferPool() {
+        for (const Buffer& buffer : free_buffers) {
+            munmap(buffer.address, buffer.capacity);
+        }
+    }
+
+    /**
+     * \brief Get a buffer of at least a given size, reusing the smallest free one that is large enough.
+     * The contents of a reused buffer are the ones left by its previous user.
+     * \param bytes The size of the buffer in bytes.
+     * \return The buffer, aligned to a page.
+     * \throw std::bad_alloc if the buffer cannot be mapped.
+     */
+    void* acquire(const std::size_t bytes) {
+        const std::lock_guard lock{mutex};
+
+        auto best = free_buffers.end();
+        for (auto buffer = free_buffers.begin(); buffer != free_buffers.end(); ++buffer) {
+            if (buffer->capacity >= bytes && (best == free_buffers.end() || buffer->capacity < best->capacity)) {
+                best = buffer;
+            }
+        }
+        if (best != free_buffers.end()) {
+            const Buffer buffer = *best;
+            free_buffers.erase(best);
+            used_buffers.push_back(buffer);
+            return buffer.address;
+        }
+
+        // The free buffers are all too small, so they are unlikely to be reused
+        for (const Buffer& buffer : free_buffers) {
+            munmap(buffer.address, buffer.capacity);
+        }
+        free_buffers.clear();
+
+        const Buffer buffer = map(bytes);
+        used_buffers.push_back(buffer);
+        return buffer.address;
+    }
+
+    /**
+     * \brief Give a buffer back to the pool, to be reused.
+     * \param address The buffer, returned by acquire().
+     */
+    void release(void* const address) {
+        const std::lock_guard lock{mutex};
+
+        for (auto buffer = used_buffers.begin(); buffer != used_buffers.end(); ++buffer) {
+            if (buffer->address == address) {
+                free_buffers.push_back(*buffer);
+                used_buffers.erase(buffer);
+                return;
+            }
+        }
+    }
+
+    /**
+     * \brief Get the pages that back the buffers.
+     * \return The huge pages setting of SPM_HUGE_PAGES.
+     */
+    [[nodiscard]] HugePages huge_pages() const {
+        return pages;
+    }
+
+private:
+
+    /**
+     * \brief A mapped buffer.
+     */
+    struct Buffer {
+        void* address; ///< The first byte of the buffer.
+        std::size_t capacity; ///< The size of the mapping in bytes.
+    };
+
+    static constexpr std::size_t huge_page_size = 2UL << 20; ///< The size of a transparent huge page (2 MiB).
+
+    const HugePages pages; ///< The pages that back the buffers.
+    std::vector<Buffer> free_buffers; ///< The buffers that can be reused.
+    std::vector<Buffer> used_buffers; ///< The buffers in use.
+    std::mutex mutex; ///< The lock of the lists of buffers.
+
+    /**
+     * \brief Constructor to read the huge pages setting.
+     */
+    BufferPool() : pages{setting()} {}
+
+    /**
+     * \brief Read the huge pages setting from the SPM_HUGE_PAGES environment variable.
+     * \return The setting, transparent huge pages if it is not set or not valid.
+     */
+    static HugePages setting() {
+        const char* const value = std::getenv("SPM_HUGE_PAGES");
+        const std::string name = value != nullptr ? value : "";
+        if (name == "off") return HugePages::Off;
+        if (name == "2M") return HugePages::Huge2M;
+        if (name == "1G") return HugePages::Huge1G;
+        return HugePages::Transparent;
+    }
+
+    /**
+     * \brief Round a size up to a multiple of an alignment.
+     * \param bytes The size in bytes.
+     * \param alignment The alignment, a power of two.
+     * \return The rounded size.
+     */
+    static std::size_t round_up(const std::size_t bytes, const std::size_t alignment) {
+        return (bytes + alignment - 1) & ~(alignment - 1);
+    }
+
+    /**
+     * \brief Map a new buffer backed by the pages of the setting, and fault all its pages in.
+     * \param bytes The size of the buffer in bytes.
+     * \return The buffer.
+     * \throw std::bad_alloc if the buffer cannot be mapped.
+     */
+    [[nodiscard]] Buffer map(const std::size_t bytes) const {
+        if (pages == HugePages::Huge2M || pages == HugePages::Huge1G) {
+            const bool gigantic = pages == HugePages::Huge1G;
+            const std::size_t capacity = round_up(bytes, gigantic ? 1UL << 30 : huge_page_size);
+            const int size_flag = (gigantic ? 30 : 21) << MAP_HUGE_SHIFT;
+            void* const address = mmap(nullptr, capacity, PROT_READ | PROT_WRITE,
+                                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | size_flag | MAP_POPULATE, -1, 0);
+            if (address != MAP_FAILED) return Buffer{address, capacity};
+        }
+
+        // Map one more huge page to align the buffer to a huge page, then unmap the unaligned ends
+        const std::size_t capacity = round_up(bytes, huge_page_size);
+        void* const mapping = mmap(nullptr, capacity + huge_page_size, PROT_READ | PROT_WRITE,
+                                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapping == MAP_FAILED) throw std::bad_alloc{};
+        const auto start = reinterpret_cast<std::size_t>(mapping);
+        const std::size_t aligned = round_up(start, huge_page_size);
+        if (aligned > start) munmap(mapping, aligned - start);
+        munmap(reinterpret_cast<void*>(aligned + capacity), start + huge_page_size - aligned);
+        void* const address = reinterpret_cast<void*>(aligned);
+
+        if (pages != HugePages::Off) madvise(address, capacity, MADV_HUGEPAGE);
+        prefault(address, capacity);
+        return Buffer{address, capacity};
+    }
+
+    /**
+     * \brief Fault all the pages of a buffer in, by writing a zero in each of them.
+     * \param address The buffer.
+     * \param capacity The size of the buffer in bytes.
+     */
+    static void prefault(void* const address, const std::size_t capacity) {
+        static const auto page_size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+        auto* const bytes = static_cast<volatile char*>(address);
+        for (std::size_t offset = 0; offset < capacity; offset += page_size) {
+            bytes[offset] = 0;
+        }
+    }
+
+};
+
+#endif //SPM_BUFFER_POOL_H
\ No newline at end of file
@@ -0,0 +1,225 @@
+#ifndef SPM_CBRT_H
+#define SPM_CBRT_H
+
+#include <immintrin.h>
+#include <cmath>
+
+#include "kernels.h"
+
+/**
+ * \brief The accuracy of the cubic roots of the upper diagonals.
+ */
+enum class CbrtMode {
+    Exact, ///< std::cbrt, element by element: the results do not depend on the batching.
+    Fast ///< SIMD Halley and Newton iterations, less than 1 ULP away from the correctly rounded cubic root.
+};
+
+/**
+ * \brief A batch cubic root kernel: replaces values[j] with its cubic root for j in [0, count).
+ */
+using CbrtKernel = void (*)(double* __restrict__ values, long count);
+
+/**
+ * \brief The number of elements whose cubic roots are computed in a batch by the sweeps.
+ */
+constexpr long cbrt_batch_size = 64;
+
+/**
+ * \brief Magic constant of the initial approximation: the high word of an IEEE double divided by 3 plus this constant
+ * is the high word of a cubic root with about 5 correct bits (as in fdlibm).
+ */
+constexpr int cbrt_magic = 715094163;
+
+/**
+ * \brief The range of magnitudes handled by the fast kernels, so that the cubes and squares of the iterations neither
+ * overflow nor lose precision. The other inputs (zeros, infinities, NaNs and extreme magnitudes) are rare, and they are
+ * computed with std::cbrt.
+ */
+constexpr double cbrt_fast_min = 0x1p-1000;
+constexpr double cbrt_fast_max = 0x1p1000; ///< \copydoc cbrt_fast_min
+
+/**
+ * \brief Recompute with std::cbrt the lanes of a vector whose inputs are out of the range of the fast kernels.
+ * \param values The cubic roots of the vector.
+ * \param inputs The inputs of the vector.
+ * \param lanes The bit mask of the lanes to recompute.
+ */
+inline void cbrt_special_lanes(double* __restrict__ const values, const double* __restrict__ const inputs, int lanes) {
+    for (int lane = 0; lanes != 0; ++lane, lanes >>= 1) {
+        if (lanes & 1) values[lane] = std::cbrt(inputs[lane]);
+    }
+}
+
+/**
+ * \brief Apply a vector cubic root to a batch, padding the last partial vector with ones.
+ * \tparam lanes The number of lanes of the vector.
+ * \param values The values, replaced with their cubic roots.
+ * \param count The number of values.
+ * \param vector The vector cubic root, in place on lanes contiguous values.
+ */
+template <long lanes, typename Vector>
+inline void cbrt_batch(double* __restrict__ const values, const long count, Vector&& vector) {
+    long j = 0;
+    for (; j <= count - lanes; j += lanes) {
+        vector(&values[j]);
+    }
+    if (j < count) {
+        double padded[lanes];
+        for (long lane = 0; lane < lanes; ++lane) {
+            padded[lane] = j + lane < count ? values[j + lane] : 1.0;
+        }
+        vector(padded);
+        for (long lane = 0; j + lane < count; ++lane) {
+            values[j + lane] = padded[lane];
+        }
+    }
+}
+
+/**
+ * \brief Exact batch cubic root: std::cbrt on each element.
+ * \param values The values, replaced with their cubic roots.
+ * \param count The number of values.
+ */
+inline void cbrt_exact(double* __restrict__ const values, const long count) {
+    for (long j = 0; j < count; ++j) {
+        values[j] = std::cbrt(values[j]);
+    }
+}
+
+/**
+ * \brief Fast batch cubic root for any x86-64 CPU, two lanes at a time.
+ * \param values The values, replaced with their cubic roots.
+ * \param count The number of values.
+ */
+__attribute__((target("sse2")))
+inline void cbrt_fast_sse2(double* __restrict__ const values, const long count) {
+    cbrt_batch<2>(values, count, [](double* const vector) __attribute__((target("sse2"))) {
+        const __m128d x = _mm_loadu_pd(vector);
+        const __m128d a = _mm_andnot_pd(_mm_set1_pd(-0.0), x);
+
+        // Initial approximation from the high words of |x|
+        const __m128i high_words = _mm_shuffle_epi32(_mm_castpd_si128(a), _MM_SHUFFLE(3, 1, 3, 1));
+        const __m128d third_words = _mm_mul_pd(_mm_cvtepi32_pd(high_words), _mm_set1_pd(1.0 / 3.0));
+        const __m128i words = _mm_add_epi32(_mm_cvttpd_epi32(third_words), _mm_set1_epi32(cbrt_magic));
+        __m128d y = _mm_castsi128_pd(_mm_unpacklo_epi32(_mm_setzero_si128(), words));
+
+        // Two Halley iterations (5 -> 15 -> 45 bits): y = y * (y^3 + 2a) / (2y^3 + a)
+        for (int iteration = 0; iteration < 2; ++iteration) {
+            const __m128d y3 = _mm_mul_pd(_mm_mul_pd(y, y), y);
+            y = _mm_mul_pd(y, _mm_div_pd(_mm_add_pd(y3, _mm_add_pd(a, a)), _mm_add_pd(_mm_add_pd(y3, y3), a)));
+        }
+        // One Newton iteration to round the last bits: y = y - (y^3 - a) / (3y^2)
+        const __m128d y2 = _mm_mul_pd(y, y);
+        y = _mm_sub_pd(y, _mm_div_pd(_mm_sub_pd(_mm_mul_pd(y2, y), a), _mm_mul_pd(_mm_set1_pd(3.0), y2)));
+
+        // Restore the sign, then fix the lanes that are out of range
+        double inputs[2];
+        _mm_storeu_pd(inputs, x);
+        _mm_storeu_pd(vector, _mm_or_pd(y, _mm_and_pd(x, _mm_set1_pd(-0.0))));
+        const __m128d special = _mm_or_pd(_mm_cmplt_pd(a, _mm_set1_pd(cbrt_fast_min)),
+                                          _mm_cmpnle_pd(a, _mm_set1_pd(cbrt_fast_max)));
+        if (const int lanes = _mm_movemask_pd(special)) cbrt_special_lanes(vector, inputs, lanes);
+    });
+}
+
+/**
+ * \brief Fast batch cubic root for AVX2 CPUs, four lanes at a time.
+ * \param values The values, replaced with their cubic roots.
+ * \param count The number of values.
+ */
+__attribute__((target("avx2,fma")))
+inline void cbrt_fast_avx2(double* __restrict__ const values, const long count) {
+    cbrt_batch<4>(values, count, [](double* const vector) __attribute__((target("avx2,fma"))) {
+        const __m256d x = _mm256_loadu_pd(vector);
+        const __m256d a = _mm256_andnot_pd(_mm256_set1_pd(-0.0), x);
+
+        // Initial approximation from the high words of |x|
+        const __m128i high_words = _mm256_castsi256_si128(
+                _mm256_permutevar8x32_epi32(_mm256_castpd_si256(a), _mm256_setr_epi32(1, 3, 5, 7, 1, 3, 5, 7)));
+        const __m256d third_words = _mm256_mul_pd(_mm256_cvtepi32_pd(high_words), _mm256_set1_pd(1.0 / 3.0));
+        const __m128i words = _mm_add_epi32(_mm256_cvttpd_epi32(third_words), _mm_set1_epi32(cbrt_magic));
+        __m256d y = _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_cvtepu32_epi64(words), 32));
+
+        // Two Halley iterations (5 -> 15 -> 45 bits): y = y * (y^3 + 2a) / (2y^3 + a)
+        for (int iteration = 0; iteration < 2; ++iteration) {
+            const __m256d y3 = _mm256_mul_pd(_mm256_mul_pd(y, y), y);
+            y = _mm256_mul_pd(y, _mm256_div_pd(_mm256_add_pd(y3, _mm256_add_pd(a, a)),
+                                               _mm256_fmadd_pd(_mm256_set1_pd(2.0), y3, a)));
+        }
+        // One Newton iteration to round the last bits: y = y - (y^3 - a) / (3y^2)
+        const __m256d y2 = _mm256_mul_pd(y, y);
+        y = _mm256_sub_pd(y, _mm256_div_pd(_mm256_fmsub_pd(y2, y, a), _mm256_mul_pd(_mm256_set1_pd(3.0), y2)));
+
+        // Restore the sign, then fix the lanes that are out of range
+        double inputs[4];
+        _mm256_storeu_pd(inputs, x);
+        _mm256_storeu_pd(vector, _mm256_or_pd(y, _mm256_and_pd(x, _mm256_set1_pd(-0.0))));
+        const __m256d special = _mm256_or_pd(_mm256_cmp_pd(a, _mm256_set1_pd(cbrt_fast_min), _CMP_LT_OQ),
+                                             _mm256_cmp_pd(a, _mm256_set1_pd(cbrt_fast_max), _CMP_NLE_UQ));
+        if (const int lanes = _mm256_movemask_pd(special)) cbrt_special_lanes(vector, inputs, lanes);
+    });
+}
+
+/**
+ * \brief Fast batch cubic root for AVX-512 CPUs, eight lanes at a time.
+ * \param values The values, replaced with their cubic roots.
+ * \param count The number of values.
+ */
+__attribute__((target("avx512f")))
+inline void cbrt_fast_avx512(double* __restrict__ const values, const long count) {
+    cbrt_batch<8>(values, count, [](double* const vector) __attribute__((target("avx512f"))) {
+        const __m512d x = _mm512_loadu_pd(vector);
+        const __m512i sign = _mm512_set1_epi64(static_cast<long long>(0x8000000000000000ULL));
+        const __m512d a = _mm512_castsi512_pd(_mm512_maskz_andnot_epi64(0xFF, sign, _mm512_castpd_si512(x)));
+
+        // Initial approximation from the high words of |x| (the masked forms avoid GCC warnings on undefined registers)
+        const __m512i high_bits = _mm512_maskz_srli_epi64(0xFF, _mm512_castpd_si512(a), 32);
+        const __m256i high_words = _mm512_maskz_cvtepi64_epi32(0xFF, high_bits);
+        const __m512d third_words = _mm512_mul_pd(_mm512_maskz_cvtepi32_pd(0xFF, high_words),
+                                                  _mm512_set1_pd(1.0 / 3.0));
+        const __m256i words = _mm256_add_epi32(_mm512_maskz_cvttpd_epi32(0xFF, third_words),
+                                               _mm256_set1_epi32(cbrt_magic));
+        __m512d y = _mm512_castsi512_pd(_mm512_maskz_slli_epi64(0xFF, _mm512_maskz_cvtepu32_epi64(0xFF, words), 32));
+
+        // Two Halley iterations (5 -> 15 -> 45 bits): y = y * (y^3 + 2a) / (2y^3 + a)
+        for (int iteration = 0; iteration < 2; ++iteration) {
+            const __m512d y3 = _mm512_mul_pd(_mm512_mul_pd(y, y), y);
+            y = _mm512_mul_pd(y, _mm512_div_pd(_mm512_add_pd(y3, _mm512_add_pd(a, a)),
+                                               _mm512_fmadd_pd(_mm512_set1_pd(2.0), y3, a)));
+        }
+        // One Newton iteration to round the last bits: y = y - (y^3 - a) / (3y^2)
+        const __m512d y2 = _mm512_mul_pd(y, y);
+        y = _mm512_sub_pd(y, _mm512_div_pd(_mm512_fmsub_pd(y2, y, a), _mm512_mul_pd(_mm512_set1_pd(3.0), y2)));
+
+        // Restore the sign, then fix the lanes that are out of range
+        double inputs[8];
+        _mm512_storeu_pd(inputs, x);
+        const __m512i sign_bits = _mm512_and_si512(_mm512_castpd_si512(x), sign);
+        _mm512_storeu_pd(vector, _mm512_castsi512_pd(_mm512_or_si512(_mm512_castpd_si512(y), sign_bits)));
+        const __mmask8 special = _mm512_cmp_pd_mask(a, _mm512_set1_pd(cbrt_fast_min), _CMP_LT_OQ) |
+                                 _mm512_cmp_pd_mask(a, _mm512_set1_pd(cbrt_fast_max), _CMP_NLE_UQ);
+        if (special) cbrt_special_lanes(vector, inputs, special);
+    });
+}
+
+/**
+ * \brief The fast batch cubic root for the instruction set selected at startup.
+ */
+inline const CbrtKernel cbrt_fast_kernel =
+        kernel_isa == "avx512" ? cbrt_fast_avx512 : kernel_isa == "avx2" ? cbrt_fast_avx2 : cbrt_fast_sse2;
+
+/**
+ * \brief Replace a batch of values with their cubic roots.
+ * \param values The values, replaced with their cubic roots.
+ * \param count The number of values.
+ * \param mode The accuracy of the cubic roots.
+ */
+inline void cbrt_batch(double* __restrict__ const values, const long count, const CbrtMode mode) {
+    if (mode == CbrtMode::Fast) {
+        cbrt_fast_kernel(values, count);
+    } else {
+        cbrt_exact(values, count);
+    }
+}
+
+#endif //SPM_CBRT_H
\ No newline at end of file
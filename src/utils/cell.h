@@ -0,0 +1,93 @@
+#ifndef SPM_CELL_H
+#define SPM_CELL_H
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "cbrt.h"
+#include "kernels.h"
+
+/**
+ * \brief The cell of the recurrence of the matrices: the element (i, j) above the main diagonal is the cubic root of
+ * the dot product of its row and its column, the sum of A(i, m) * A(m + 1, j) for m in [i, j).
+ *
+ * A cell type defines the recurrence of the upper diagonals run by the matrices, which are templates on it so that
+ * its functions are inlined in the sweeps. It has:
+ * - sum_of_products, true if the reduction is the dot product: the sweeps then split it in partial sums, for the
+ *   bands of diagonals and the tiles;
+ * - reduce(row, column, i, j), the reduction of the element (i, j) from row[m - i] = A(i, m) and
+ *   column[m - i] = A(m + 1, j) for m in [i, j), widened to double;
+ * - finalize(values, count, cbrt_mode), the element from its reduction, in place on a batch of elements of a diagonal.
+ */
+struct CbrtDotProduct {
+
+    static constexpr bool sum_of_products = true; ///< The reduction is the dot product.
+
+    /**
+     * \brief Reduce an element: the dot product, with the SIMD kernel selected at startup.
+     * \tparam T The type of the elements.
+     * \param row The row of the element, from the main diagonal.
+     * \param column The column of the element, from the row below the main diagonal.
+     * \param i The row of the element.
+     * \param j The column of the element.
+     * \return The dot product.
+     */
+    template <typename T>
+    [[nodiscard]] double reduce(const T* __restrict__ const row, const T* __restrict__ const column, const long i,
+                                const long j) const {
+        return dot_product_kernel<T>(row, column, j - i);
+    }
+
+    /**
+     * \brief Finalize a batch of elements: the cubic roots.
+     * \param values The dot products of the elements, replaced with their cubic roots.
+     * \param count The number of elements.
+     * \param cbrt_mode The accuracy of the cubic roots.
+     */
+    void finalize(double* __restrict__ const values, const long count, const CbrtMode cbrt_mode) const {
+        cbrt_batch(values, count, cbrt_mode);
+    }
+
+};
+
+/**
+ * \brief The cell of the matrix chain ordering: the element (i, j) is the fewest scalar multiplications to compute the
+ * product of the matrices i to j, the minimum of A(i, m) + A(m + 1, j) + p(i) p(m + 1) p(j + 1) for m in [i, j),
+ * where matrix i has p(i) rows and p(i + 1) columns. The main diagonal must be zeros.
+ */
+struct ChainProduct {
+
+    static constexpr bool sum_of_products = false; ///< The reduction is a minimum.
+
+    std::vector<double> dimensions; ///< The dimensions p of the matrices, one more than the size of the matrix.
+
+    /**
+     * \brief Reduce an element: the cheapest split of the product.
+     * \tparam T The type of the elements.
+     * \param row The row of the element, from the main diagonal.
+     * \param column The column of the element, from the row below the main diagonal.
+     * \param i The row of the element.
+     * \param j The column of the element.
+     * \return The cost of the cheapest split.
+     */
+    template <typename T>
+    [[nodiscard]] double reduce(const T* __restrict__ const row, const T* __restrict__ const column, const long i,
+                                const long j) const {
+        const double* __restrict__ const p = dimensions.data();
+        const double outer = p[i] * p[j + 1];
+        double cost = std::numeric_limits<double>::infinity();
+        for (long m = 0; m < j - i; ++m) {
+            cost = std::min(cost, static_cast<double>(row[m]) + static_cast<double>(column[m]) + outer * p[i + m + 1]);
+        }
+        return cost;
+    }
+
+    /**
+     * \brief Finalize a batch of elements: the costs are the elements.
+     */
+    void finalize(double* __restrict__, long, CbrtMode) const {}
+
+};
+
+#endif //SPM_CELL_H
\ No newline at end of file
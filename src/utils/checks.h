@@ -0,0 +1,206 @@
+#ifndef SPM_CHECKS_H
+#define SPM_CHECKS_H
+
+#include <cmath>
+#include <algorithm>
+#include <exception>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "benchmark.h"
+#include "cell.h"
+#include "matrix.h"
+#include "triangle_file.h"
+
+/**
+ * \brief Check the stream of the diagonals of a matrix: sweep it again with a consumer that sums each diagonal,
+ * and compare the sum of all of them with the checksum of the matrix, printing an error if they differ.
+ * The consumer adds the elements by diagonal and the checksum by row, so the sums only match up to rounding.
+ * \param matrix The matrix.
+ * \param sweep The function that sets the upper diagonals of the matrix by diagonals.
+ * \return true if the consumer received each diagonal once, in order, and the sums match, false otherwise.
+ */
+template <typename T, typename Cell, typename Sweep>
+bool check_stream(Matrix<T, Cell>& matrix, Sweep&& sweep) {
+    long next = 0;
+    bool ordered = true;
+    double sum = 0.0;
+    matrix.stream_diagonals([&](const long k, const std::span<const T> diagonal) {
+        ordered = ordered && k == next++;
+        for (const T element : diagonal) {
+            sum += element;
+        }
+    });
+    sweep();
+    matrix.stream_diagonals({});
+
+    const double checksum = matrix.checksum();
+    if (!ordered || next != matrix.get_diagonals() + 1) {
+        std::cerr << "Stream mismatch: " << next << " diagonals instead of " << matrix.get_diagonals() + 1
+                  << std::endl;
+        return false;
+    }
+    if (std::abs(sum - checksum) <= checksum_tolerance(Precision::Double) * std::abs(checksum)) return true;
+
+    std::cerr << "Stream mismatch: the diagonals sum to " << std::setprecision(17) << sum << " instead of "
+              << checksum << std::endl;
+    return false;
+}
+
+/**
+ * \brief Check the updates of the main diagonal: double a few elements of the main diagonal of a matrix with its
+ * upper diagonals set, update the matrix in place, and compare it with a new matrix swept from the changed main
+ * diagonal, printing an error if they differ.
+ * \tparam UpdatedMatrix The type of the matrix.
+ * \tparam Sweep The type of the function that sets the upper diagonals of a matrix.
+ * \tparam Update The type of the function that updates the main diagonal of a matrix.
+ * \param dimension The size of the matrix.
+ * \param diagonals The number of upper diagonals of the matrices (0 means all of them).
+ * \param precision The precision of the matrix.
+ * \param sweep The function that sets the upper diagonals of a matrix.
+ * \param update The function that updates the main diagonal of a matrix and its upper diagonals.
+ * \return true if the updated matrix matches the new one, false otherwise.
+ */
+template <typename UpdatedMatrix, typename Sweep, typename Update>
+bool check_update(const long dimension, const long diagonals, const Precision precision, Sweep&& sweep,
+                  Update&& update) {
+    std::vector<double> diagonal(dimension);
+    for (long i = 0; i < dimension; ++i) {
+        diagonal[i] = static_cast<double>(i + 1) / static_cast<double>(dimension);
+    }
+    const UpdatedMatrix matrix{dimension, diagonal, {}, diagonals};
+    sweep(matrix);
+
+    // The elements at a quarter, at the half and at three quarters of the main diagonal
+    typename UpdatedMatrix::DiagonalUpdate changes;
+    for (const long row : {dimension / 4, dimension / 2, 3 * dimension / 4}) {
+        diagonal[row] *= 2.0;
+        changes.emplace_back(row, diagonal[row]);
+    }
+    update(matrix, changes);
+
+    const UpdatedMatrix reference{dimension, diagonal, {}, diagonals};
+    sweep(reference);
+    const double error = matrix.max_relative_error(reference);
+    if (error <= checksum_tolerance(precision)) return true;
+
+    std::cerr << "Update mismatch for dimension " << dimension << ": maximum relative error " << error << std::endl;
+    return false;
+}
+
+/**
+ * \brief Check the lazy evaluations of the elements: evaluate a few elements of a new matrix, with overlapping
+ * dependency cones and a repeated one, then the last element of each row, whose cones cover the whole triangle (the
+ * first one alone without a band), and compare them and the whole matrix with a matrix swept by diagonals, printing
+ * an error if they differ. With a band, the columns of the elements are clamped to the band.
+ * \tparam LazyMatrix The type of the matrix.
+ * \tparam Sweep The type of the function that sets the upper diagonals of a matrix.
+ * \tparam Evaluate The type of the function that evaluates an element of a matrix.
+ * \param dimension The size of the matrix.
+ * \param diagonals The number of upper diagonals of the matrices (0 means all of them).
+ * \param precision The precision of the matrix.
+ * \param sweep The function that sets the upper diagonals of a matrix.
+ * \param evaluate The function that evaluates an element of a matrix, given its row and its column.
+ * \return true if the evaluated elements and the whole matrix match the swept one, false otherwise.
+ */
+template <typename LazyMatrix, typename Sweep, typename Evaluate>
+bool check_evaluate(const long dimension, const long diagonals, const Precision precision, Sweep&& sweep,
+                    Evaluate&& evaluate) {
+    const LazyMatrix reference{dimension, {}, {}, diagonals};
+    sweep(reference);
+
+    // The second and the third cones overlap the first one, which is then evaluated again from memory
+    const long last = dimension - 1;
+    std::vector<std::pair<long, long>> queries{{dimension / 4, 3 * last / 4}, {0, last / 2}, {last / 2, last},
+                                               {dimension / 4, 3 * last / 4}};
+    for (long row = 0; row < dimension; ++row) {
+        queries.emplace_back(row, last);
+    }
+
+    const LazyMatrix matrix{dimension, {}, {}, diagonals};
+    double error = 0.0;
+    for (const auto& [row, last_column] : queries) {
+        const long column = std::min(last_column, row + matrix.get_diagonals());
+        const double expected = reference.get(row, column);
+        error = std::max(error, std::abs(evaluate(matrix, row, column) - expected) / std::abs(expected));
+    }
+    error = std::max(error, matrix.max_relative_error(reference));
+    if (error <= checksum_tolerance(precision)) return true;
+
+    std::cerr << "Evaluation mismatch for dimension " << dimension << ": maximum relative error " << error
+              << std::endl;
+    return false;
+}
+
+/**
+ * \brief Check a sweep with the cell of the matrix chain ordering problem, on the instance with the dimensions
+ * 30x35, 35x15, 15x5, 5x10, 10x20 and 20x25: the cheapest product of all the matrices costs 15125 scalar
+ * multiplications, the one of the first three 7875 and the one of the second to the fifth 7125.
+ * Printing an error if the costs differ.
+ * \tparam ChainMatrix The type of the matrix, with ChainProduct as the cell.
+ * \tparam Sweep The type of the function that sets the upper diagonals of a matrix.
+ * \param sweep The function that sets the upper diagonals of a matrix.
+ * \return true if the costs match, false otherwise.
+ */
+template <typename ChainMatrix, typename Sweep>
+bool check_chain_product(Sweep&& sweep) {
+    const ChainProduct cell{{30, 35, 15, 5, 10, 20, 25}};
+    const long size = static_cast<long>(cell.dimensions.size()) - 1;
+    const ChainMatrix matrix{size, std::vector<double>(size, 0.0), cell};
+    sweep(matrix);
+    if (matrix.get(0, size - 1) == 15125 && matrix.get(0, 2) == 7875 && matrix.get(1, 4) == 7125) return true;
+
+    std::cerr << "Chain product mismatch: " << matrix.get(0, size - 1) << " scalar multiplications instead of 15125"
+              << std::endl;
+    return false;
+}
+
+/**
+ * \brief Get the path of the file of a matrix saved by a benchmark.
+ * \param name The name of the benchmark.
+ * \param dimension The size of the matrix.
+ * \return The path, <name>_<dimension>.triangle in the results directory.
+ */
+inline std::string triangle_path(const std::string& name, const long dimension) {
+    return std::filesystem::current_path() / "results" / (name + "_" + std::to_string(dimension) + ".triangle");
+}
+
+/**
+ * \brief Save a matrix (see Matrix::save() and MPIMatrix::save()), then map the file back and verify it, printing an
+ * error if it cannot be written or it does not match the matrix.
+ * The saves and the checksums of the MPI matrices are collective, so all the processes call it and one verifies.
+ * \tparam SavedMatrix The class template of the matrix.
+ * \tparam T The type of the elements.
+ * \tparam Cell The cell of the recurrence.
+ * \param matrix The matrix, with its upper diagonals set.
+ * \param name The name of the benchmark, for the path of the file (see triangle_path()).
+ * \param dimension The size of the matrix.
+ * \param verify Whether to verify the file (default is true).
+ * \return true if the file was written and, if verified, its size, its checksum and its elements match the matrix.
+ */
+template <template <typename, typename> class SavedMatrix, typename T, typename Cell>
+bool check_save(const SavedMatrix<T, Cell>& matrix, const std::string& name, const long dimension,
+                const bool verify = true) {
+    const std::string path = triangle_path(name, dimension);
+    try {
+        matrix.save(path);
+        const double checksum = matrix.checksum();
+        if (!verify) return true;
+
+        const TriangleFile<T> file{path};
+        if (file.size() == dimension && file.checksum() == checksum && file.verify()) return true;
+
+        std::cerr << "Save mismatch: " << path << " does not match the matrix of dimension " << dimension
+                  << std::endl;
+    } catch (const std::exception& error) {
+        std::cerr << error.what() << std::endl;
+    }
+    return false;
+}
+
+#endif //SPM_CHECKS_H
\ No newline at end of file
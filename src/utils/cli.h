@@ -0,0 +1,35 @@
+#ifndef SPM_CLI_H
+#define SPM_CLI_H
+
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+/**
+ * \brief Parses a non-negative integer command line argument.
+ * On failure, an error message is printed to the standard error.
+ *
+ * @param arg The command line argument to parse
+ * @param value The parsed value
+ * @return true if the argument is a valid non-negative integer, false otherwise
+ */
+inline bool parseLong(const char* arg, long& value) {
+    try {
+        const unsigned long ul_value = std::stoul(arg);
+        if (ul_value > static_cast<unsigned long>(std::numeric_limits<long>::max())) {
+            std::cerr << "Invalid argument: " << arg << " is too large." << std::endl;
+            return false;
+        }
+        value = static_cast<long>(ul_value);
+    } catch ([[maybe_unused]] const std::invalid_argument &e) {
+        std::cerr << "Invalid argument: " << arg << " is not a valid number." << std::endl;
+        return false;
+    } catch ([[maybe_unused]] const std::out_of_range &e) {
+        std::cerr << "Invalid argument: " << arg << " is out of range." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+#endif //SPM_CLI_H
\ No newline at end of file
@@ -2,10 +2,36 @@
 #define SPM_CSV_H
 
 #include <fstream>
+#include <iomanip>
+#include <sstream>
 #include <string>
 #include <vector>
 #include <filesystem>
 
+/**
+ * \brief Formats a floating point value the same way writeCSV writes it
+ *
+ * @param value The value to format
+ * @return The formatted value
+ */
+inline std::string toCSVField(const double value) {
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(8) << value;
+    return oss.str();
+}
+
+/**
+ * \brief Formats a floating point value in scientific notation, for values too small for toCSVField
+ *
+ * @param value The value to format
+ * @return The formatted value
+ */
+inline std::string toCSVScientificField(const double value) {
+    std::ostringstream oss;
+    oss << std::scientific << std::setprecision(6) << value;
+    return oss.str();
+}
+
 /**
  * \brief Writes data to a CSV file
  *
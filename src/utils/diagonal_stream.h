@@ -0,0 +1,168 @@
+#ifndef SPM_DIAGONAL_STREAM_H
+#define SPM_DIAGONAL_STREAM_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+/**
+ * \brief A stream of the diagonals of a sweep, from the threads computing them to a consumer running on its own
+ * thread, so that the consumer of diagonal k overlaps with the computation of the next ones.
+ * The sweep writes the elements of each diagonal directly into one of depth slots, and the consumer receives a view
+ * of the slot. The sweep waits before starting diagonal k until the consumer is done with diagonal k - depth, so a
+ * slow consumer holds back the sweep instead of piling up diagonals in memory.
+ * \tparam T The type of the elements.
+ */
+template <typename T>
+class DiagonalStream {
+
+public:
+
+    /**
+     * \brief A function called with each diagonal, in order, and the view of its elements by row.
+     * The view is only valid during the call.
+     */
+    using Consumer = std::function<void(long, std::span<const T>)>;
+
+    /**
+     * \brief Constructor to start the thread of the consumer.
+     * \param size The size of the matrix (the length of the main diagonal).
+     * \param consumer The consumer of the diagonals.
+     * \param depth The number of diagonals computed ahead of the consumer, at least 1.
+     */
+    DiagonalStream(const long size, Consumer consumer, const long depth) :
+    size{size},
+    depth{std::max(depth, 1L)},
+    slots(this->depth * size),
+    consumer{std::move(consumer)},
+    thread{[this]() { consume(); }}
+    {}
+
+    DiagonalStream(const DiagonalStream&) = delete;
+    DiagonalStream& operator=(const DiagonalStream&) = delete;
+
+    /**
+     * \brief Destructor to stop and join the thread of the consumer, after the diagonals already completed.
+     */
+    ~DiagonalStream() {
+        {
+            const std::lock_guard lock{mutex};
+            stopping = true;
+        }
+        published_changed.notify_all();
+        thread.join();
+    }
+
+    /**
+     * \brief Start a new sweep, with the main diagonal complete.
+     * \param main_diagonal The function that returns the element of a row of the main diagonal.
+     */
+    void start(const std::function<T(long)>& main_diagonal) {
+        {
+            // A sweep interrupted by an exception may have left diagonals to the consumer
+            std::unique_lock lock{mutex};
+            consumed_changed.wait(lock, [&]() { return consumed == published; });
+            published = consumed = 0;
+            error = nullptr;
+        }
+        T* const diagonal = slot(0);
+        for (long i = 0; i < size; ++i) {
+            diagonal[i] = main_diagonal(i);
+        }
+        publish(0);
+    }
+
+    /**
+     * \brief Wait until the slot of a diagonal is free, before the diagonal is computed.
+     * \param k The diagonal.
+     */
+    void acquire(const long k) {
+        std::unique_lock lock{mutex};
+        consumed_changed.wait(lock, [&]() { return consumed > k - depth; });
+    }
+
+    /**
+     * \brief Get the slot of a diagonal, where its elements are written by row.
+     * \param k The diagonal, acquired.
+     * \return The first element of the slot.
+     */
+    [[nodiscard]] T* slot(const long k) {
+        return &slots[(k % depth) * size];
+    }
+
+    /**
+     * \brief Pass a complete diagonal to the consumer. The diagonals are published in order.
+     * \param k The diagonal.
+     */
+    void publish(const long k) {
+        {
+            const std::lock_guard lock{mutex};
+            published = k + 1;
+        }
+        published_changed.notify_one();
+    }
+
+    /**
+     * \brief Wait until the consumer is done with all the published diagonals, at the end of a sweep.
+     * \throw Any exception thrown by the consumer in the sweep.
+     */
+    void finish() {
+        std::unique_lock lock{mutex};
+        consumed_changed.wait(lock, [&]() { return consumed == published; });
+        if (error) {
+            const std::exception_ptr thrown = error;
+            error = nullptr;
+            std::rethrow_exception(thrown);
+        }
+    }
+
+private:
+
+    const long size; ///< The size of the matrix.
+    const long depth; ///< The number of slots.
+    std::vector<T> slots; ///< The slots of the diagonals, size elements each.
+    const Consumer consumer; ///< The consumer of the diagonals.
+    std::mutex mutex; ///< The lock of the counters.
+    std::condition_variable published_changed; ///< Notified when a diagonal is published or the stream stops.
+    std::condition_variable consumed_changed; ///< Notified when the consumer is done with a diagonal.
+    long published = 0; ///< The number of diagonals published in the current sweep.
+    long consumed = 0; ///< The number of diagonals the consumer is done with in the current sweep.
+    bool stopping = false; ///< Whether the stream is being destroyed.
+    std::exception_ptr error; ///< The exception thrown by the consumer, if any.
+    std::thread thread; ///< The thread of the consumer, started last.
+
+    /**
+     * \brief The loop of the thread of the consumer: pass each published diagonal to the consumer, in order.
+     * After an exception, the diagonals are skipped until the end of the sweep.
+     */
+    void consume() {
+        std::unique_lock lock{mutex};
+        while (true) {
+            published_changed.wait(lock, [&]() { return consumed < published || stopping; });
+            if (consumed == published) return;
+
+            const long k = consumed;
+            if (!error) {
+                lock.unlock();
+                try {
+                    consumer(k, std::span<const T>{slot(k), static_cast<std::size_t>(size - k)});
+                } catch (...) {
+                    lock.lock();
+                    error = std::current_exception();
+                    lock.unlock();
+                }
+                lock.lock();
+            }
+            ++consumed;
+            consumed_changed.notify_all();
+        }
+    }
+
+};
+
+#endif //SPM_DIAGONAL_STREAM_H
\ No newline at end of file
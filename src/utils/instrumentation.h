@@ -0,0 +1,368 @@
+#ifndef SPM_INSTRUMENTATION_H
+#define SPM_INSTRUMENTATION_H
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "csv.h"
+
+/**
+ * \brief Whether the sweeps are instrumented, set with the SPM_INSTRUMENT CMake option.
+ * Without it, all the methods of Instrumentation are empty and are removed by the compiler.
+ */
+#ifdef SPM_INSTRUMENT
+constexpr bool instrumentation_enabled = true;
+#else
+constexpr bool instrumentation_enabled = false;
+#endif
+
+/**
+ * \brief Get the length of the dot products of the elements of a diagonal in a band of diagonals, for the trace.
+ * The first diagonal of the band also counts the partial sums of all the diagonals of the band.
+ * \param k The first diagonal of the band.
+ * \param s The diagonal in the band.
+ * \param band The number of diagonals of the band.
+ * \return The length of the dot product of each element.
+ */
+inline long band_dot_product_length(const long k, const long s, const long band) {
+    return band - 1 + s + (s == 0 ? band * (k - band + 1) : 0);
+}
+
+/**
+ * \brief The hardware counters of the calling thread: cycles, instructions and last level cache misses.
+ * They count in user space only. If the kernel does not allow them (see /proc/sys/kernel/perf_event_paranoid),
+ * they are not available and they read as zero.
+ */
+class HardwareCounters {
+
+public:
+
+    static constexpr int events = 3; ///< The number of counters.
+
+    /**
+     * \brief Constructor to open the counters of the calling thread.
+     */
+    HardwareCounters() :
+    fds{open_counter(PERF_COUNT_HW_CPU_CYCLES), open_counter(PERF_COUNT_HW_INSTRUCTIONS),
+        open_counter(PERF_COUNT_HW_CACHE_MISSES)}
+    {}
+
+    HardwareCounters(const HardwareCounters&) = delete;
+    HardwareCounters& operator=(const HardwareCounters&) = delete;
+
+    /**
+     * \brief Destructor to close the counters.
+     */
+    ~HardwareCounters() {
+        for (const int fd : fds) {
+            if (fd >= 0) close(fd);
+        }
+    }
+
+    /**
+     * \brief Check whether the counters are available.
+     * \return true if all the counters could be opened, false otherwise.
+     */
+    [[nodiscard]] bool available() const {
+        return fds[0] >= 0 && fds[1] >= 0 && fds[2] >= 0;
+    }
+
+    /**
+     * \brief Read the counters.
+     * \param values The values of the counters (zero for the ones that are not available).
+     */
+    void read(std::uint64_t (&values)[events]) const {
+        for (int e = 0; e < events; ++e) {
+            values[e] = 0;
+            if (fds[e] >= 0 && ::read(fds[e], &values[e], sizeof(values[e])) != sizeof(values[e])) {
+                values[e] = 0;
+            }
+        }
+    }
+
+    /**
+     * \brief Get the counters of the calling thread, opened the first time.
+     * \return The counters.
+     */
+    static HardwareCounters& of_this_thread() {
+        thread_local HardwareCounters counters;
+        return counters;
+    }
+
+private:
+
+    const int fds[events]; ///< The file descriptors of the counters (-1 if not available).
+
+    /**
+     * \brief Open a hardware counter of the calling thread.
+     * \param config The counter.
+     * \return The file descriptor of the counter, -1 if it is not available.
+     */
+    static int open_counter(const std::uint64_t config) {
+        perf_event_attr attr{};
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = config;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+
+};
+
+/**
+ * \brief A trace of a sweep over the diagonals of a matrix.
+ * For each diagonal it records the wall-clock interval, the time spent in communication by the calling thread and,
+ * for each worker, the time spent computing and its hardware counters. The idle time of a worker in a diagonal
+ * (waiting at the barrier, or for the communication) is the rest of the interval.
+ * The GFLOP/s and GB/s are derived from the multiply-adds of the dot products and the operands they read
+ * (from the caches or the memory).
+ */
+class Instrumentation {
+
+    using Clock = std::chrono::steady_clock;
+
+public:
+
+    /**
+     * \brief Start the trace of a sweep, discarding the previous one.
+     * \param element_size The size in bytes of an element of the matrix.
+     */
+    void start(const std::size_t element_size) {
+        if constexpr (!instrumentation_enabled) return;
+
+        bytes_per_element = element_size;
+        diagonals.clear();
+        worker_ids.clear();
+        origin = Clock::now();
+    }
+
+    /**
+     * \brief Begin the record of a diagonal, called by the thread that drives the sweep.
+     * \param k The diagonal.
+     */
+    void begin_diagonal(const long k) {
+        if constexpr (!instrumentation_enabled) return;
+
+        current = Diagonal{k, seconds(Clock::now()), 0.0, 0.0, 0.0, 0.0, {}};
+    }
+
+    /**
+     * \brief End the record of a diagonal, called by the thread that drives the sweep.
+     * \param rows The number of dot products computed in the diagonal (by this process).
+     * \param length The length of each dot product.
+     */
+    void end_diagonal(const long rows, const long length) {
+        if constexpr (!instrumentation_enabled) return;
+
+        current.end = seconds(Clock::now());
+        current.flops = 2.0 * static_cast<double>(rows) * static_cast<double>(length);
+        current.bytes = current.flops * static_cast<double>(bytes_per_element);
+        diagonals.push_back(current);
+    }
+
+    /**
+     * \brief A piece of work of a worker in the current diagonal, measured from its construction to its destruction.
+     * Many workers can measure their work at the same time.
+     */
+    class Work {
+
+    public:
+
+        /**
+         * \brief Constructor to start measuring the work of the calling worker.
+         * \param instrumentation The trace of the sweep.
+         */
+        explicit Work(Instrumentation& instrumentation) : instrumentation{instrumentation} {
+            if constexpr (!instrumentation_enabled) return;
+
+            HardwareCounters::of_this_thread().read(before);
+            start = Clock::now();
+        }
+
+        Work(const Work&) = delete;
+        Work& operator=(const Work&) = delete;
+
+        /**
+         * \brief Destructor to add the time and the hardware counters of the work to the worker.
+         */
+        ~Work() {
+            if constexpr (!instrumentation_enabled) return;
+
+            const auto end = Clock::now();
+            const HardwareCounters& counters = HardwareCounters::of_this_thread();
+            std::uint64_t after[HardwareCounters::events];
+            counters.read(after);
+
+            const std::lock_guard lock{instrumentation.mutex};
+            Worker& worker = instrumentation.current_worker();
+            worker.busy += std::chrono::duration<double>(end - start).count();
+            worker.counted = counters.available();
+            for (int e = 0; e < HardwareCounters::events; ++e) {
+                worker.counters[e] += after[e] - before[e];
+            }
+        }
+
+    private:
+
+        Instrumentation& instrumentation; ///< The trace of the sweep.
+        std::uint64_t before[HardwareCounters::events]{}; ///< The hardware counters at the start of the work.
+        Clock::time_point start; ///< The start of the work.
+    };
+
+    /**
+     * \brief A communication in the current diagonal, measured from its construction to its destruction.
+     * It must be done by the thread that drives the sweep.
+     */
+    class Communication {
+
+    public:
+
+        /**
+         * \brief Constructor to start measuring the communication.
+         * \param instrumentation The trace of the sweep.
+         */
+        explicit Communication(Instrumentation& instrumentation) : instrumentation{instrumentation} {
+            if constexpr (!instrumentation_enabled) return;
+
+            start = Clock::now();
+        }
+
+        Communication(const Communication&) = delete;
+        Communication& operator=(const Communication&) = delete;
+
+        /**
+         * \brief Destructor to add the time of the communication to the current diagonal.
+         */
+        ~Communication() {
+            if constexpr (!instrumentation_enabled) return;
+
+            instrumentation.current.communication += std::chrono::duration<double>(Clock::now() - start).count();
+        }
+
+    private:
+
+        Instrumentation& instrumentation; ///< The trace of the sweep.
+        Clock::time_point start; ///< The start of the communication.
+    };
+
+    /**
+     * \brief Start measuring some work of the calling worker in the current diagonal.
+     * \return The work, measured until it is destroyed.
+     */
+    [[nodiscard]] Work work() {
+        return Work{*this};
+    }
+
+    /**
+     * \brief Start measuring a communication in the current diagonal.
+     * \return The communication, measured until it is destroyed.
+     */
+    [[nodiscard]] Communication communication() {
+        return Communication{*this};
+    }
+
+    /**
+     * \brief Check whether the trace has no diagonals (without SPM_INSTRUMENT, or for the tiled sweeps).
+     * \return true if no diagonal was recorded, false otherwise.
+     */
+    [[nodiscard]] bool empty() const {
+        return diagonals.empty();
+    }
+
+    /**
+     * \brief Write the trace as a CSV file in the results directory, one row per diagonal and worker.
+     * The times are in seconds from the start of the sweep. The counters are empty if they are not available.
+     * \param filename The name of the file.
+     */
+    void write(const std::string& filename) const {
+        if constexpr (!instrumentation_enabled) return;
+
+        const std::vector<std::string> headers{"Diagonal", "Start", "End", "Compute Time", "Communication Time",
+                                               "GFLOP/s", "GB/s", "Worker", "Busy Time", "Idle Time", "Cycles",
+                                               "Instructions", "LLC Misses"};
+        std::vector<std::vector<std::string>> rows;
+        for (const Diagonal& diagonal : diagonals) {
+            const double time = diagonal.end - diagonal.start;
+            // The workers that did not take part in a diagonal were idle for all of it
+            for (std::size_t w = 0; w < worker_ids.size(); ++w) {
+                const Worker& worker = w < diagonal.workers.size() ? diagonal.workers[w] : Worker{};
+                std::vector<std::string> row{std::to_string(diagonal.k), toCSVField(diagonal.start),
+                                             toCSVField(diagonal.end), toCSVField(time - diagonal.communication),
+                                             toCSVField(diagonal.communication),
+                                             toCSVField(time > 0.0 ? diagonal.flops / time / 1e9 : 0.0),
+                                             toCSVField(time > 0.0 ? diagonal.bytes / time / 1e9 : 0.0),
+                                             std::to_string(w), toCSVField(worker.busy),
+                                             toCSVField(time - worker.busy)};
+                for (const std::uint64_t counter : worker.counters) {
+                    row.push_back(worker.counted ? std::to_string(counter) : "");
+                }
+                rows.push_back(std::move(row));
+            }
+        }
+        writeCSV<std::string>(filename, headers, rows);
+    }
+
+private:
+
+    /**
+     * \brief The record of a worker in a diagonal.
+     */
+    struct Worker {
+        double busy = 0.0; ///< The time spent computing.
+        bool counted = false; ///< Whether the hardware counters are available.
+        std::uint64_t counters[HardwareCounters::events]{}; ///< The hardware counters.
+    };
+
+    /**
+     * \brief The record of a diagonal.
+     */
+    struct Diagonal {
+        long k; ///< The diagonal.
+        double start; ///< The start of the diagonal.
+        double end; ///< The end of the diagonal.
+        double communication; ///< The time spent in communication.
+        double flops; ///< The floating-point operations of the dot products.
+        double bytes; ///< The bytes read by the dot products.
+        std::vector<Worker> workers; ///< The records of the workers, by worker index.
+    };
+
+    std::size_t bytes_per_element = sizeof(double); ///< The size in bytes of an element of the matrix.
+    Clock::time_point origin; ///< The start of the sweep.
+    Diagonal current{}; ///< The record of the current diagonal.
+    std::vector<Diagonal> diagonals; ///< The records of the completed diagonals.
+    std::map<std::thread::id, std::size_t> worker_ids; ///< The index of each worker, in order of appearance.
+    std::mutex mutex; ///< The lock of the records of the workers.
+
+    /**
+     * \brief Get the time since the start of the sweep.
+     * \param time The time point.
+     * \return The time in seconds since the start of the sweep.
+     */
+    [[nodiscard]] double seconds(const Clock::time_point time) const {
+        return std::chrono::duration<double>(time - origin).count();
+    }
+
+    /**
+     * \brief Get the record of the calling worker in the current diagonal (the lock must be held).
+     * \return The record of the worker.
+     */
+    Worker& current_worker() {
+        const auto [entry, inserted] = worker_ids.try_emplace(std::this_thread::get_id(), worker_ids.size());
+        if (current.workers.size() <= entry->second) {
+            current.workers.resize(entry->second + 1);
+        }
+        return current.workers[entry->second];
+    }
+
+};
+
+#endif //SPM_INSTRUMENTATION_H
\ No newline at end of file
@@ -0,0 +1,436 @@
+#ifndef SPM_KERNELS_H
+#define SPM_KERNELS_H
+
+#include <immintrin.h>
+#include <cstdlib>
+#include <string>
+
+/**
+ * \brief A dot product kernel: sums row[j] * column[j] for j in [0, length).
+ * \tparam T The type of the elements of the vectors (double, or float widened to double in registers).
+ */
+template <typename T>
+using DotProductKernel = double (*)(const T* __restrict__ row, const T* __restrict__ column, long length);
+
+/**
+ * \brief Load two elements as doubles.
+ * \param source The first element.
+ * \return The elements.
+ */
+__attribute__((target("sse2")))
+inline __m128d load_sse2(const double* const source) {
+    return _mm_loadu_pd(source);
+}
+
+/**
+ * \brief Load two elements as doubles.
+ * \param source The first element.
+ * \return The elements, widened to double.
+ */
+__attribute__((target("sse2")))
+inline __m128d load_sse2(const float* const source) {
+    return _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(source))));
+}
+
+/**
+ * \brief Load four elements as doubles.
+ * \param source The first element.
+ * \return The elements.
+ */
+__attribute__((target("avx2,fma")))
+inline __m256d load_avx2(const double* const source) {
+    return _mm256_loadu_pd(source);
+}
+
+/**
+ * \brief Load four elements as doubles.
+ * \param source The first element.
+ * \return The elements, widened to double.
+ */
+__attribute__((target("avx2,fma")))
+inline __m256d load_avx2(const float* const source) {
+    return _mm256_cvtps_pd(_mm_loadu_ps(source));
+}
+
+/**
+ * \brief Load eight elements as doubles.
+ * \param source The first element.
+ * \return The elements.
+ */
+__attribute__((target("avx512f")))
+inline __m512d load_avx512(const double* const source) {
+    return _mm512_loadu_pd(source);
+}
+
+/**
+ * \brief Load eight elements as doubles.
+ * \param source The first element.
+ * \return The elements, widened to double.
+ */
+__attribute__((target("avx512f")))
+inline __m512d load_avx512(const float* const source) {
+    return _mm512_maskz_cvtps_pd(0xFF, _mm256_loadu_ps(source));
+}
+
+/**
+ * \brief Load up to eight elements as doubles, the others are zero.
+ * \param mask The elements to load.
+ * \param source The first element.
+ * \return The elements.
+ */
+__attribute__((target("avx512f")))
+inline __m512d load_masked_avx512(const __mmask8 mask, const double* const source) {
+    return _mm512_maskz_loadu_pd(mask, source);
+}
+
+/**
+ * \brief Load up to eight elements as doubles, the others are zero.
+ * The lower half of the 512-bit register is extracted with a masked form to avoid GCC warnings on undefined registers.
+ * \param mask The elements to load.
+ * \param source The first element.
+ * \return The elements, widened to double.
+ */
+__attribute__((target("avx512f")))
+inline __m512d load_masked_avx512(const __mmask8 mask, const float* const source) {
+    const __m512 elements = _mm512_maskz_loadu_ps(mask, source);
+    const __m256d lower = _mm512_maskz_extractf64x4_pd(0xFF, _mm512_castps_pd(elements), 0);
+    return _mm512_maskz_cvtps_pd(0xFF, _mm256_castpd_ps(lower));
+}
+
+/**
+ * \brief Dot product for any x86-64 CPU, with four SSE2 accumulators.
+ * \param row The first vector.
+ * \param column The second vector.
+ * \param length The length of the vectors.
+ * \return The dot product.
+ */
+template <typename T>
+__attribute__((target("sse2")))
+inline double dot_product_sse2(const T* __restrict__ const row, const T* __restrict__ const column,
+                               const long length) {
+    __m128d sum0 = _mm_setzero_pd();
+    __m128d sum1 = _mm_setzero_pd();
+    __m128d sum2 = _mm_setzero_pd();
+    __m128d sum3 = _mm_setzero_pd();
+
+    long j = 0;
+    for (; j <= length - 8; j += 8) {
+        sum0 = _mm_add_pd(sum0, _mm_mul_pd(load_sse2(&row[j]), load_sse2(&column[j])));
+        sum1 = _mm_add_pd(sum1, _mm_mul_pd(load_sse2(&row[j + 2]), load_sse2(&column[j + 2])));
+        sum2 = _mm_add_pd(sum2, _mm_mul_pd(load_sse2(&row[j + 4]), load_sse2(&column[j + 4])));
+        sum3 = _mm_add_pd(sum3, _mm_mul_pd(load_sse2(&row[j + 6]), load_sse2(&column[j + 6])));
+    }
+    for (; j <= length - 2; j += 2) {
+        sum0 = _mm_add_pd(sum0, _mm_mul_pd(load_sse2(&row[j]), load_sse2(&column[j])));
+    }
+
+    // Reduce the accumulators, then the two lanes
+    const __m128d sum = _mm_add_pd(_mm_add_pd(sum0, sum1), _mm_add_pd(sum2, sum3));
+    double result = _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+
+    // Handle the remaining element
+    if (j < length) {
+        result += static_cast<double>(row[j]) * column[j];
+    }
+    return result;
+}
+
+/**
+ * \brief Dot product for AVX2 CPUs, with four FMA accumulators.
+ * \param row The first vector.
+ * \param column The second vector.
+ * \param length The length of the vectors.
+ * \return The dot product.
+ */
+template <typename T>
+__attribute__((target("avx2,fma")))
+inline double dot_product_avx2(const T* __restrict__ const row, const T* __restrict__ const column,
+                               const long length) {
+    __m256d sum0 = _mm256_setzero_pd();
+    __m256d sum1 = _mm256_setzero_pd();
+    __m256d sum2 = _mm256_setzero_pd();
+    __m256d sum3 = _mm256_setzero_pd();
+
+    long j = 0;
+    for (; j <= length - 16; j += 16) {
+        sum0 = _mm256_fmadd_pd(load_avx2(&row[j]), load_avx2(&column[j]), sum0);
+        sum1 = _mm256_fmadd_pd(load_avx2(&row[j + 4]), load_avx2(&column[j + 4]), sum1);
+        sum2 = _mm256_fmadd_pd(load_avx2(&row[j + 8]), load_avx2(&column[j + 8]), sum2);
+        sum3 = _mm256_fmadd_pd(load_avx2(&row[j + 12]), load_avx2(&column[j + 12]), sum3);
+    }
+    for (; j <= length - 4; j += 4) {
+        sum0 = _mm256_fmadd_pd(load_avx2(&row[j]), load_avx2(&column[j]), sum0);
+    }
+
+    // Reduce the accumulators, then the two halves, then the two lanes
+    const __m256d sum = _mm256_add_pd(_mm256_add_pd(sum0, sum1), _mm256_add_pd(sum2, sum3));
+    const __m128d half = _mm_add_pd(_mm256_castpd256_pd128(sum), _mm256_extractf128_pd(sum, 1));
+    double result = _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+
+    // Handle the remaining elements
+    for (; j < length; ++j) {
+        result += static_cast<double>(row[j]) * column[j];
+    }
+    return result;
+}
+
+/**
+ * \brief Dot product for AVX-512 CPUs, with four FMA accumulators and a masked tail.
+ * \param row The first vector.
+ * \param column The second vector.
+ * \param length The length of the vectors.
+ * \return The dot product.
+ */
+template <typename T>
+__attribute__((target("avx512f")))
+inline double dot_product_avx512(const T* __restrict__ const row, const T* __restrict__ const column,
+                                 const long length) {
+    __m512d sum0 = _mm512_setzero_pd();
+    __m512d sum1 = _mm512_setzero_pd();
+    __m512d sum2 = _mm512_setzero_pd();
+    __m512d sum3 = _mm512_setzero_pd();
+
+    long j = 0;
+    for (; j <= length - 32; j += 32) {
+        sum0 = _mm512_fmadd_pd(load_avx512(&row[j]), load_avx512(&column[j]), sum0);
+        sum1 = _mm512_fmadd_pd(load_avx512(&row[j + 8]), load_avx512(&column[j + 8]), sum1);
+        sum2 = _mm512_fmadd_pd(load_avx512(&row[j + 16]), load_avx512(&column[j + 16]), sum2);
+        sum3 = _mm512_fmadd_pd(load_avx512(&row[j + 24]), load_avx512(&column[j + 24]), sum3);
+    }
+    for (; j <= length - 8; j += 8) {
+        sum0 = _mm512_fmadd_pd(load_avx512(&row[j]), load_avx512(&column[j]), sum0);
+    }
+
+    // Handle the remaining elements with a masked load
+    if (j < length) {
+        const __mmask8 mask = static_cast<__mmask8>((1u << (length - j)) - 1);
+        sum1 = _mm512_fmadd_pd(load_masked_avx512(mask, &row[j]), load_masked_avx512(mask, &column[j]), sum1);
+    }
+
+    // Reduce the accumulators, then the two halves, then the two quarters, then the two lanes
+    const __m512d sum = _mm512_add_pd(_mm512_add_pd(sum0, sum1), _mm512_add_pd(sum2, sum3));
+    const __m256d half = _mm256_add_pd(_mm512_maskz_extractf64x4_pd(0xFF, sum, 0),
+                                       _mm512_maskz_extractf64x4_pd(0xFF, sum, 1));
+    const __m128d quarter = _mm_add_pd(_mm256_castpd256_pd128(half), _mm256_extractf128_pd(half, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(quarter, _mm_unpackhi_pd(quarter, quarter)));
+}
+
+constexpr long strip_width = 4; ///< The number of dot products computed together by a strip kernel.
+
+/**
+ * \brief A strip kernel: computes strip_width dot products sharing the same row,
+ * results[s] = sum of row[j] * columns[s][j] for j in [0, length).
+ * Each row vector is loaded once and kept in a register for all the columns.
+ * \tparam T The type of the elements of the vectors (double, or float widened to double in registers).
+ */
+template <typename T>
+using DotProductStripKernel = void (*)(const T* __restrict__ row, const T* const* columns, long length,
+                                       double* __restrict__ results);
+
+/**
+ * \brief Strip kernel for any x86-64 CPU, with one SSE2 accumulator per column.
+ * \param row The shared vector.
+ * \param columns The strip_width vectors multiplied by the shared one.
+ * \param length The length of the vectors.
+ * \param results The strip_width dot products.
+ */
+template <typename T>
+__attribute__((target("sse2")))
+inline void dot_product_strip_sse2(const T* __restrict__ const row, const T* const* const columns,
+                                   const long length, double* __restrict__ const results) {
+    const T* __restrict__ const column0 = columns[0];
+    const T* __restrict__ const column1 = columns[1];
+    const T* __restrict__ const column2 = columns[2];
+    const T* __restrict__ const column3 = columns[3];
+    __m128d sum0 = _mm_setzero_pd();
+    __m128d sum1 = _mm_setzero_pd();
+    __m128d sum2 = _mm_setzero_pd();
+    __m128d sum3 = _mm_setzero_pd();
+
+    long j = 0;
+    for (; j <= length - 2; j += 2) {
+        const __m128d r = load_sse2(&row[j]);
+        sum0 = _mm_add_pd(sum0, _mm_mul_pd(r, load_sse2(&column0[j])));
+        sum1 = _mm_add_pd(sum1, _mm_mul_pd(r, load_sse2(&column1[j])));
+        sum2 = _mm_add_pd(sum2, _mm_mul_pd(r, load_sse2(&column2[j])));
+        sum3 = _mm_add_pd(sum3, _mm_mul_pd(r, load_sse2(&column3[j])));
+    }
+
+    // Reduce the two lanes of each accumulator: {sum0, sum1} and {sum2, sum3} pairwise
+    const __m128d sums01 = _mm_add_pd(_mm_unpacklo_pd(sum0, sum1), _mm_unpackhi_pd(sum0, sum1));
+    const __m128d sums23 = _mm_add_pd(_mm_unpacklo_pd(sum2, sum3), _mm_unpackhi_pd(sum2, sum3));
+    _mm_storeu_pd(&results[0], sums01);
+    _mm_storeu_pd(&results[2], sums23);
+
+    // Handle the remaining element
+    if (j < length) {
+        results[0] += static_cast<double>(row[j]) * column0[j];
+        results[1] += static_cast<double>(row[j]) * column1[j];
+        results[2] += static_cast<double>(row[j]) * column2[j];
+        results[3] += static_cast<double>(row[j]) * column3[j];
+    }
+}
+
+/**
+ * \brief Strip kernel for AVX2 CPUs, with two FMA accumulators per column.
+ * \param row The shared vector.
+ * \param columns The strip_width vectors multiplied by the shared one.
+ * \param length The length of the vectors.
+ * \param results The strip_width dot products.
+ */
+template <typename T>
+__attribute__((target("avx2,fma")))
+inline void dot_product_strip_avx2(const T* __restrict__ const row, const T* const* const columns,
+                                   const long length, double* __restrict__ const results) {
+    const T* __restrict__ const column0 = columns[0];
+    const T* __restrict__ const column1 = columns[1];
+    const T* __restrict__ const column2 = columns[2];
+    const T* __restrict__ const column3 = columns[3];
+    __m256d sum0 = _mm256_setzero_pd(), other0 = _mm256_setzero_pd();
+    __m256d sum1 = _mm256_setzero_pd(), other1 = _mm256_setzero_pd();
+    __m256d sum2 = _mm256_setzero_pd(), other2 = _mm256_setzero_pd();
+    __m256d sum3 = _mm256_setzero_pd(), other3 = _mm256_setzero_pd();
+
+    long j = 0;
+    for (; j <= length - 8; j += 8) {
+        const __m256d r = load_avx2(&row[j]);
+        const __m256d s = load_avx2(&row[j + 4]);
+        sum0 = _mm256_fmadd_pd(r, load_avx2(&column0[j]), sum0);
+        sum1 = _mm256_fmadd_pd(r, load_avx2(&column1[j]), sum1);
+        sum2 = _mm256_fmadd_pd(r, load_avx2(&column2[j]), sum2);
+        sum3 = _mm256_fmadd_pd(r, load_avx2(&column3[j]), sum3);
+        other0 = _mm256_fmadd_pd(s, load_avx2(&column0[j + 4]), other0);
+        other1 = _mm256_fmadd_pd(s, load_avx2(&column1[j + 4]), other1);
+        other2 = _mm256_fmadd_pd(s, load_avx2(&column2[j + 4]), other2);
+        other3 = _mm256_fmadd_pd(s, load_avx2(&column3[j + 4]), other3);
+    }
+    for (; j <= length - 4; j += 4) {
+        const __m256d r = load_avx2(&row[j]);
+        sum0 = _mm256_fmadd_pd(r, load_avx2(&column0[j]), sum0);
+        sum1 = _mm256_fmadd_pd(r, load_avx2(&column1[j]), sum1);
+        sum2 = _mm256_fmadd_pd(r, load_avx2(&column2[j]), sum2);
+        sum3 = _mm256_fmadd_pd(r, load_avx2(&column3[j]), sum3);
+    }
+    sum0 = _mm256_add_pd(sum0, other0);
+    sum1 = _mm256_add_pd(sum1, other1);
+    sum2 = _mm256_add_pd(sum2, other2);
+    sum3 = _mm256_add_pd(sum3, other3);
+
+    // Transpose-and-add the four accumulators, so that lane s holds the sum of accumulator s
+    const __m256d sums01 = _mm256_hadd_pd(sum0, sum1);
+    const __m256d sums23 = _mm256_hadd_pd(sum2, sum3);
+    const __m256d sums = _mm256_add_pd(_mm256_permute2f128_pd(sums01, sums23, 0x20),
+                                       _mm256_permute2f128_pd(sums01, sums23, 0x31));
+    _mm256_storeu_pd(results, sums);
+
+    // Handle the remaining elements
+    for (; j < length; ++j) {
+        results[0] += static_cast<double>(row[j]) * column0[j];
+        results[1] += static_cast<double>(row[j]) * column1[j];
+        results[2] += static_cast<double>(row[j]) * column2[j];
+        results[3] += static_cast<double>(row[j]) * column3[j];
+    }
+}
+
+/**
+ * \brief Strip kernel for AVX-512 CPUs, with two FMA accumulators per column and a masked tail.
+ * \param row The shared vector.
+ * \param columns The strip_width vectors multiplied by the shared one.
+ * \param length The length of the vectors.
+ * \param results The strip_width dot products.
+ */
+template <typename T>
+__attribute__((target("avx512f")))
+inline void dot_product_strip_avx512(const T* __restrict__ const row, const T* const* const columns,
+                                     const long length, double* __restrict__ const results) {
+    const T* __restrict__ const column0 = columns[0];
+    const T* __restrict__ const column1 = columns[1];
+    const T* __restrict__ const column2 = columns[2];
+    const T* __restrict__ const column3 = columns[3];
+    __m512d sum0 = _mm512_setzero_pd(), other0 = _mm512_setzero_pd();
+    __m512d sum1 = _mm512_setzero_pd(), other1 = _mm512_setzero_pd();
+    __m512d sum2 = _mm512_setzero_pd(), other2 = _mm512_setzero_pd();
+    __m512d sum3 = _mm512_setzero_pd(), other3 = _mm512_setzero_pd();
+
+    long j = 0;
+    for (; j <= length - 16; j += 16) {
+        const __m512d r = load_avx512(&row[j]);
+        const __m512d s = load_avx512(&row[j + 8]);
+        sum0 = _mm512_fmadd_pd(r, load_avx512(&column0[j]), sum0);
+        sum1 = _mm512_fmadd_pd(r, load_avx512(&column1[j]), sum1);
+        sum2 = _mm512_fmadd_pd(r, load_avx512(&column2[j]), sum2);
+        sum3 = _mm512_fmadd_pd(r, load_avx512(&column3[j]), sum3);
+        other0 = _mm512_fmadd_pd(s, load_avx512(&column0[j + 8]), other0);
+        other1 = _mm512_fmadd_pd(s, load_avx512(&column1[j + 8]), other1);
+        other2 = _mm512_fmadd_pd(s, load_avx512(&column2[j + 8]), other2);
+        other3 = _mm512_fmadd_pd(s, load_avx512(&column3[j + 8]), other3);
+    }
+    // Handle the remaining elements with masked loads
+    for (; j < length; j += 8) {
+        const __mmask8 mask = length - j >= 8 ? 0xFF : static_cast<__mmask8>((1u << (length - j)) - 1);
+        const __m512d r = load_masked_avx512(mask, &row[j]);
+        sum0 = _mm512_fmadd_pd(r, load_masked_avx512(mask, &column0[j]), sum0);
+        sum1 = _mm512_fmadd_pd(r, load_masked_avx512(mask, &column1[j]), sum1);
+        sum2 = _mm512_fmadd_pd(r, load_masked_avx512(mask, &column2[j]), sum2);
+        sum3 = _mm512_fmadd_pd(r, load_masked_avx512(mask, &column3[j]), sum3);
+    }
+    sum0 = _mm512_add_pd(sum0, other0);
+    sum1 = _mm512_add_pd(sum1, other1);
+    sum2 = _mm512_add_pd(sum2, other2);
+    sum3 = _mm512_add_pd(sum3, other3);
+
+    // Fold each accumulator to 256 bits, then transpose-and-add as in the AVX2 kernel
+    const __m256d half0 = _mm256_add_pd(_mm512_maskz_extractf64x4_pd(0xFF, sum0, 0),
+                                        _mm512_maskz_extractf64x4_pd(0xFF, sum0, 1));
+    const __m256d half1 = _mm256_add_pd(_mm512_maskz_extractf64x4_pd(0xFF, sum1, 0),
+                                        _mm512_maskz_extractf64x4_pd(0xFF, sum1, 1));
+    const __m256d half2 = _mm256_add_pd(_mm512_maskz_extractf64x4_pd(0xFF, sum2, 0),
+                                        _mm512_maskz_extractf64x4_pd(0xFF, sum2, 1));
+    const __m256d half3 = _mm256_add_pd(_mm512_maskz_extractf64x4_pd(0xFF, sum3, 0),
+                                        _mm512_maskz_extractf64x4_pd(0xFF, sum3, 1));
+    const __m256d sums01 = _mm256_hadd_pd(half0, half1);
+    const __m256d sums23 = _mm256_hadd_pd(half2, half3);
+    _mm256_storeu_pd(results, _mm256_add_pd(_mm256_permute2f128_pd(sums01, sums23, 0x20),
+                                            _mm256_permute2f128_pd(sums01, sums23, 0x31)));
+}
+
+/**
+ * \brief Get the name of the instruction set of the dot product kernel to use.
+ * It is the widest one supported by the CPU, unless the SPM_KERNEL environment variable
+ * asks for a narrower one (sse2, avx2 or avx512).
+ * \return The name of the instruction set.
+ */
+inline std::string select_kernel_isa() {
+    __builtin_cpu_init();
+    std::string isa = "sse2";
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) isa = "avx2";
+    if (__builtin_cpu_supports("avx512f")) isa = "avx512";
+
+    if (const char* requested = std::getenv("SPM_KERNEL")) {
+        const std::string name{requested};
+        if (name == "sse2" || (name == "avx2" && isa == "avx512")) isa = name;
+    }
+    return isa;
+}
+
+inline const std::string kernel_isa = select_kernel_isa(); ///< The instruction set of the selected kernels.
+
+/**
+ * \brief The dot product kernel for the instruction set selected at startup.
+ * \tparam T The type of the elements of the vectors.
+ */
+template <typename T>
+inline const DotProductKernel<T> dot_product_kernel =
+        kernel_isa == "avx512" ? dot_product_avx512<T> :
+        kernel_isa == "avx2" ? dot_product_avx2<T> : dot_product_sse2<T>;
+
+/**
+ * \brief The strip kernel for the instruction set selected at startup.
+ * \tparam T The type of the elements of the vectors.
+ */
+template <typename T>
+inline const DotProductStripKernel<T> dot_product_strip_kernel =
+        kernel_isa == "avx512" ? dot_product_strip_avx512<T> :
+        kernel_isa == "avx2" ? dot_product_strip_avx2<T> : dot_product_strip_sse2<T>;
+
+#endif //SPM_KERNELS_H
\ No newline at end of file
@@ -1,51 +1,122 @@
 #ifndef SPM_MATRIX_H
 #define SPM_MATRIX_H
 
+#include <xmmintrin.h>
 #include <iostream>
 #include <iomanip>
-#include <mm_malloc.h>
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "cbrt.h"
+#include "cell.h"
+#include "diagonal_stream.h"
+#include "instrumentation.h"
+#include "kernels.h"
+#include "storage.h"
+#include "triangle_file.h"
+#include "tuning.h"
 
 /**
  * \brief A class to represent an upper triangular matrix stored in a 1D array.
+ * \tparam T The type of the stored elements: double, or float to halve the memory and the bandwidth of the sweeps.
+ * The dot products and the cubic roots are always computed in double precision, the results are rounded on store.
+ * \tparam Cell The recurrence of the upper diagonals (see CbrtDotProduct). The bands of diagonals and the tiles need
+ * a cell whose reduction is the dot product, with another one the diagonals are computed one by one.
+ *
+ * A matrix can hold only the first upper diagonals, a band of the triangle: the element (i, j) only reads the
+ * elements (r, c) with i <= r <= c <= j, so the first K diagonals only need the first K diagonals. The band is stored
+ * row by row in strides of K + 1 elements (padded after the last column), and its transpose column by column, in
+ * O(size * K) memory instead of O(size^2); the sweeps stop at diagonal K.
  */
+template <typename T = double, typename Cell = CbrtDotProduct>
 class Matrix {
 
 public:
 
+    /**
+     * \brief A consumer of the diagonals of the sweeps (see stream_diagonals()).
+     */
+    using DiagonalConsumer = typename DiagonalStream<T>::Consumer;
+
+    /**
+     * \brief Changed elements of the main diagonal, as pairs of row and new value.
+     */
+    using DiagonalUpdate = std::vector<std::pair<long, double>>;
+
     /**
      * \brief Constructor to initialize the matrix with a given size.
      * \param size The size of the matrix (number of rows and columns).
+     * \param initialize Whether to initialize the main diagonal, otherwise the derived class must initialize all the
+     * rows with initialize_rows(), and the triangles do not come from the buffer pool (default is true).
+     * \param cell The cell of the recurrence (default is a default-constructed one).
+     * \param diagonals The number of upper diagonals stored and computed (default is 0, which means all of them).
      */
-    explicit Matrix(const long size) :
+    explicit Matrix(const long size, const bool initialize = true, const Cell& cell = {}, const long diagonals = 0) :
     size{size},
-    // Allocate memory for the matrix and its transpose using aligned memory allocation (32 bytes) for AVX2 instructions
-    data{static_cast<double*>(_mm_malloc(size * (size + 1) / 2 * sizeof(double), 32))},
-    data_t{static_cast<double*>(_mm_malloc(size * (size + 1) / 2 * sizeof(double), 32))}
+    diagonals{diagonals > 0 && diagonals < size - 1 ? diagonals : std::max(size - 1, 0L)},
+    banded{this->diagonals < size - 1},
+    tuning{TuningProfile::get().settings(size)},
+    cell{cell},
+    // Allocate the matrix and its transpose in pooled or aligned memory (32 bytes) for AVX2 instructions, or in mapped
+    // files. The rows initialized by the derived class are placed by the threads that write them, out of the pool.
+    data_storage{banded ? size * (this->diagonals + 1) : size * (size + 1) / 2, initialize},
+    data_t_storage{banded ? size * (this->diagonals + 1) : size * (size + 1) / 2, initialize},
+    data{data_storage.get()},
+    data_t{data_t_storage.get()},
+    last_computed(std::max(size, 0L))
     {
-        // Initialize the matrix with the values on the main diagonal (1/size, 2/size, 3/size, ..., size/size)
+        // Only the main diagonal is computed
         for (long i = 0; i < size; ++i) {
-            data[index(i, i)] = static_cast<double>(i + 1) / static_cast<double>(size);
-            data_t[index(i, i)] = static_cast<double>(i + 1) / static_cast<double>(size);
+            last_computed[i] = i;
+        }
+
+        // Initialize the matrix with the values on the main diagonal (1/size, 2/size, 3/size, ..., size/size)
+        for (long i = 0; initialize && i < size; ++i) {
+            data[index(i, i)] = static_cast<T>(static_cast<double>(i + 1) / static_cast<double>(size));
+            data_t[transposed_index(i, i)] = static_cast<T>(static_cast<double>(i + 1) / static_cast<double>(size));
         }
 
     }
 
     /**
-     * \brief Destructor to free allocated memory.
+     * \brief Constructor to initialize the matrix with a given main diagonal.
+     * \param size The size of the matrix (number of rows and columns).
+     * \param diagonal The main diagonal, size elements (empty for the default one, as in the other constructor).
+     * \param cell The cell of the recurrence (default is a default-constructed one).
+     * \param diagonals The number of upper diagonals stored and computed (default is 0, which means all of them).
+     * \throw std::invalid_argument if the diagonal has the wrong number of elements.
      */
-    virtual ~Matrix() {
-        _mm_free(data);
-        _mm_free(data_t);
+    Matrix(const long size, const std::vector<double>& diagonal, const Cell& cell = {}, const long diagonals = 0) :
+    Matrix(size, true, cell, diagonals) {
+        if (diagonal.empty()) return;
+        if (static_cast<long>(diagonal.size()) != size) {
+            throw std::invalid_argument("The main diagonal must have " + std::to_string(size) + " elements");
+        }
+
+        for (long i = 0; i < size; ++i) {
+            data[index(i, i)] = static_cast<T>(diagonal[i]);
+            data_t[transposed_index(i, i)] = static_cast<T>(diagonal[i]);
+        }
     }
 
     /**
-     * \brief Print the matrix to the standard output.
+     * \brief Destructor, the storage frees the allocated memory.
+     */
+    virtual ~Matrix() = default;
+
+    /**
+     * \brief Print the matrix to the standard output, with zeros out of the band.
      */
     void print() const {
         std::ostringstream oss;
         for (long i = 0; i < size; ++i) {
             for (long j = 0; j < size; ++j) {
-                if (j >= i) {
+                if (j >= i && j <= last_column(i)) {
                     oss << std::setw(9) << std::setprecision(6) << std::fixed << data[index(i, j)] << " ";
                 } else {
                     oss << std::setw(10) << "0 ";
@@ -57,21 +128,582 @@ public:
         std::cout << oss.str() << std::flush;
     }
 
+    /**
+     * \brief Get an element of the upper triangle.
+     * \param row The row of the element.
+     * \param column The column of the element (row <= column <= row + get_diagonals()).
+     * \return The element, widened to double.
+     */
+    [[nodiscard]] double get(const long row, const long column) const {
+        return data[index(row, column)];
+    }
+
+    /**
+     * \brief Get the number of upper diagonals stored and computed.
+     * \return The width of the band, size - 1 for the whole triangle.
+     */
+    [[nodiscard]] long get_diagonals() const {
+        return diagonals;
+    }
+
+    /**
+     * \brief Compare the upper triangle with the one of another matrix of the same size,
+     * on the diagonals stored by both.
+     * \tparam U The type of the elements of the other matrix.
+     * \param other The reference matrix.
+     * \return The maximum relative error of the elements with respect to the reference.
+     */
+    template <typename U, typename OtherCell>
+    [[nodiscard]] double max_relative_error(const Matrix<U, OtherCell>& other) const {
+        double error = 0.0;
+        for (long i = 0; i < size; ++i) {
+            for (long j = i; j <= std::min(last_column(i), i + other.get_diagonals()); ++j) {
+                const double reference = other.get(i, j);
+                error = std::max(error, std::abs(get(i, j) - reference) / std::abs(reference));
+            }
+        }
+        return error;
+    }
+
+    /**
+     * \brief Get the trace of the last sweep over the diagonals (empty without SPM_INSTRUMENT).
+     * \return The trace.
+     */
+    [[nodiscard]] const Instrumentation& get_instrumentation() const {
+        return instrumentation;
+    }
+
+    /**
+     * \brief Save the packed upper triangle in a binary file, with its size, precision and checksum
+     * (see write_triangle()), to be mapped back with TriangleFile.
+     * \param path The path of the file, replaced if it exists.
+     * \throw std::invalid_argument if the matrix only holds a band of the triangle.
+     * \throw std::runtime_error if the file cannot be written.
+     */
+    void save(const std::string& path) const {
+        if (banded) {
+            throw std::invalid_argument("Only the whole upper triangle can be saved, not a band");
+        }
+        write_triangle(path, size, data, checksum());
+    }
+
+    /**
+     * \brief Stream the diagonals of the next sweeps to a consumer, on its own thread, as soon as each one is complete:
+     * first the main diagonal, then the upper diagonals in order, each as a view of its elements by row, valid only
+     * during the call. The elements are stored in the view as they are computed, so it costs no copy of the matrix.
+     * The sweep computes at most depth diagonals ahead of the consumer, then waits for it; a sweep returns once the
+     * consumer is done with its last diagonal, and rethrows the first exception of the consumer (which then skips
+     * the rest of the sweep).
+     * Only the sweeps by diagonals stream (set_upper_diagonals()), not the tiled ones.
+     * \param consumer The consumer, or an empty function to stop streaming.
+     * \param depth The number of diagonals computed ahead of the consumer (default is 2).
+     */
+    void stream_diagonals(DiagonalConsumer consumer, const long depth = 2) {
+        stream.reset();
+        if (consumer) stream = std::make_unique<DiagonalStream<T>>(size, std::move(consumer), depth);
+    }
+
+    /**
+     * \brief Compute the checksum of the matrix, to compare the results of the backends.
+     * \return The sum of the elements of the upper triangle (of the band), row by row.
+     */
+    [[nodiscard]] double checksum() const {
+        double sum = 0.0;
+        for (long i = 0; i < size; ++i) {
+            const T* const row = &data[index(i, i)];
+            for (long c = 0; c <= last_column(i) - i; ++c) {
+                sum += row[c];
+            }
+        }
+        return sum;
+    }
+
 protected:
     const long size; ///< The size of the matrix (number of rows and columns).
-    double* __restrict__ const data; ///< The data buffer for the matrix.
-    double* __restrict__ const data_t;  ///< The data buffer for the transposed matrix.
+    const long diagonals; ///< The number of upper diagonals stored and computed (size - 1 for the whole triangle).
+    const bool banded; ///< Whether only a band of the triangle is stored, in strides of diagonals + 1 elements.
+    const TuningSettings tuning; ///< The kernel settings of the tuning profile for the size of the matrix.
+    const Cell cell; ///< The cell of the recurrence.
+    const Storage<T> data_storage; ///< The storage of the matrix.
+    const Storage<T> data_t_storage; ///< The storage of the transposed matrix.
+    T* __restrict__ const data; ///< The data buffer for the matrix.
+    T* __restrict__ const data_t;  ///< The data buffer for the transposed matrix.
+    mutable Instrumentation instrumentation; ///< The trace of the last sweep over the diagonals.
+    std::unique_ptr<DiagonalStream<T>> stream; ///< The stream of the diagonals to a consumer, if any.
+    mutable std::vector<long> last_computed; ///< The last computed column of each row, for the lazy evaluation.
+
+    /**
+     * \brief Initialize some rows of the matrix and of its transpose, writing all their elements,
+     * so that their pages are placed on the NUMA node of the calling thread (unless a memory policy is set).
+     * \param first The first row.
+     * \param last The row past the last one.
+     */
+    void initialize_rows(const long first, const long last) const {
+        for (long i = first; i < last; ++i) {
+            const auto value = static_cast<T>(static_cast<double>(i + 1) / static_cast<double>(size));
+            std::fill(&data[index(i, i)], &data[index(i, last_column(i))] + 1, T{});
+            std::fill(&data_t[transposed_index(i, first_row(i))], &data_t[transposed_index(i, i)] + 1, T{});
+            data[index(i, i)] = value;
+            data_t[transposed_index(i, i)] = value;
+        }
+    }
+
+    /**
+     * \brief Change some elements of the main diagonal, in the matrix and in its transpose.
+     * \param update The changed elements.
+     * \return The changed rows, sorted and without duplicates.
+     * \throw std::invalid_argument if a row is out of the matrix.
+     */
+    std::vector<long> set_main_diagonal(const DiagonalUpdate& update) const {
+        std::vector<long> changed;
+        for (const auto& [row, value] : update) {
+            if (row < 0 || row >= size) {
+                throw std::invalid_argument("The row " + std::to_string(row) + " is out of the matrix");
+            }
+            data[index(row, row)] = static_cast<T>(value);
+            data_t[transposed_index(row, row)] = static_cast<T>(value);
+            changed.push_back(row);
+        }
+        std::sort(changed.begin(), changed.end());
+        changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+        return changed;
+    }
+
+    /**
+     * \brief Get the chunks of rows of a diagonal whose elements depend on some changed elements of the main diagonal.
+     * The element (r, r + k) only reads the elements (m, m) with r <= m <= r + k, through its row and its column, so
+     * a changed row d affects the rows [d - k, d] of diagonal k; the ranges of the changed rows are merged, clipped to
+     * the diagonal and split in chunks of at most the tuned chunk of rows.
+     * \param changed The changed rows of the main diagonal, sorted.
+     * \param k The diagonal.
+     * \return The chunks, as pairs of first row and row past the last one, in order.
+     */
+    [[nodiscard]] std::vector<std::pair<long, long>> affected_chunks(const std::vector<long>& changed,
+                                                                     const long k) const {
+        std::vector<std::pair<long, long>> chunks;
+        for (std::size_t c = 0; c < changed.size();) {
+            const long first = std::max(changed[c] - k, 0L);
+            long last = changed[c] + 1;
+            for (++c; c < changed.size() && changed[c] - k <= last; ++c) {
+                last = changed[c] + 1;
+            }
+            last = std::min(last, size - k);
+            for (long i = first; i < last; i += tuning.chunk) {
+                chunks.emplace_back(i, std::min(i + tuning.chunk, last));
+            }
+        }
+        return chunks;
+    }
 
     /**
      * \brief Calculate the index in the 1D array for a given row and column.
+     * In a band, each row takes diagonals + 1 elements, from the main diagonal on.
      * \param row The row index.
-     * \param column The column index.
+     * \param column The column index (row <= column <= row + diagonals).
      * \return The index in the 1D array.
      */
     [[nodiscard]] long index(const long row, const long column) const {
+        if (banded) return row * (diagonals + 1) + column - row;
         return row * (2 * size - row + 1) / 2 + column - row;
     }
 
+    /**
+     * \brief Calculate the index in the 1D array of the transposed matrix for a given row and column.
+     * The transposed matrix is lower triangular, so each of its rows (a column of the matrix) is stored contiguously.
+     * In a band, each of its rows takes diagonals + 1 elements, up to the main diagonal.
+     * \param row The row index in the transposed matrix (column of the matrix).
+     * \param column The column index in the transposed matrix (row of the matrix), with
+     * row - diagonals <= column <= row.
+     * \return The index in the 1D array.
+     */
+    [[nodiscard]] long transposed_index(const long row, const long column) const {
+        if (banded) return row * (diagonals + 1) + diagonals - row + column;
+        return row * (row + 1) / 2 + column;
+    }
+
+    /**
+     * \brief Get the last column of a row that is stored.
+     * \param row The row.
+     * \return The last column of the band in the row, size - 1 for the whole triangle.
+     */
+    [[nodiscard]] long last_column(const long row) const {
+        return std::min(row + diagonals, size - 1);
+    }
+
+    /**
+     * \brief Get the first row of a column that is stored.
+     * \param column The column.
+     * \return The first row of the band in the column, 0 for the whole triangle.
+     */
+    [[nodiscard]] long first_row(const long column) const {
+        return std::max(column - diagonals, 0L);
+    }
+
+    /**
+     * \brief Check that the whole triangle is stored, for the sweeps that do not stop at the band.
+     * \throw std::invalid_argument if the matrix only holds a band of the triangle.
+     */
+    void require_whole_triangle() const {
+        if (banded) {
+            throw std::invalid_argument("The tiled sweeps need the whole upper triangle, not a band");
+        }
+    }
+
+    /**
+     * \brief Get the first diagonal of a sweep computed in bands of strip_width diagonals.
+     * \param register_blocking Whether to compute the diagonals in bands with the strip kernel.
+     * \return The first diagonal of the bands, diagonals + 1 if there are none (without register blocking, or if the
+     * reduction of the cell is not the dot product).
+     */
+    [[nodiscard]] long first_band_diagonal(const bool register_blocking) const {
+        return register_blocking && Cell::sum_of_products ? std::min(strip_width, diagonals + 1) : diagonals + 1;
+    }
+
+    /**
+     * \brief Start a sweep over the diagonals: start its trace, and pass the main diagonal to the consumer of the
+     * stream, if any.
+     */
+    void start_sweep() const {
+        instrumentation.start(sizeof(T));
+        if (stream) stream->start([&](const long i) { return data[index(i, i)]; });
+    }
+
+    /**
+     * \brief Finish a sweep over the diagonals: wait until the consumer of the stream, if any, is done with them.
+     * \throw Any exception thrown by the consumer in the sweep.
+     */
+    void finish_sweep() const {
+        mark_computed();
+        if (stream) stream->finish();
+    }
+
+    /**
+     * \brief Record that all the elements are computed, at the end of a sweep, so that the lazy evaluation returns
+     * them as they are.
+     */
+    void mark_computed() const {
+        std::fill(last_computed.begin(), last_computed.end(), size - 1);
+    }
+
+    /**
+     * \brief Check an element for the lazy evaluation.
+     * \param row The row of the element.
+     * \param column The column of the element.
+     * \return true if the element is already computed, false if its dependency cone must be.
+     * \throw std::invalid_argument if the element is not in the upper triangle, or not in its band.
+     */
+    [[nodiscard]] bool is_computed(const long row, const long column) const {
+        if (row < 0 || row > column || column >= size || column - row > diagonals) {
+            throw std::invalid_argument("The element (" + std::to_string(row) + ", " + std::to_string(column) +
+                                        ") is not in the upper diagonals of the matrix");
+        }
+        return last_computed[row] >= column;
+    }
+
+    /**
+     * \brief Get the chunks of rows of a diagonal in the dependency cone of an element that are not computed yet.
+     * The element (row, column) reads the elements (r, c) with row <= r <= c <= column, the sub-triangle of the rows
+     * from row to column. The elements computed by the previous evaluations are the first ones of each row, up to
+     * its last computed column: the union of sub-triangles is still a prefix of each row.
+     * \param row The row of the element.
+     * \param column The column of the element.
+     * \param k The diagonal, less than or equal to column - row.
+     * \return The chunks, as pairs of first row and row past the last one, in order.
+     */
+    [[nodiscard]] std::vector<std::pair<long, long>> missing_chunks(const long row, const long column,
+                                                                    const long k) const {
+        std::vector<std::pair<long, long>> chunks;
+        for (long r = row; r <= column - k;) {
+            if (last_computed[r] >= r + k) {
+                ++r;
+                continue;
+            }
+            const long first = r;
+            while (r <= column - k && last_computed[r] < r + k && r - first < tuning.chunk) {
+                ++r;
+            }
+            chunks.emplace_back(first, r);
+        }
+        return chunks;
+    }
+
+    /**
+     * \brief Record that the dependency cone of an element is computed.
+     * \param row The row of the element.
+     * \param column The column of the element.
+     */
+    void cone_computed(const long row, const long column) const {
+        for (long r = row; r <= column; ++r) {
+            last_computed[r] = std::max(last_computed[r], column);
+        }
+    }
+
+    /**
+     * \brief Start a diagonal of a sweep: start its trace, and wait for its slot in the stream, if any, so that the
+     * sweep is at most the depth of the stream ahead of its consumer.
+     * \param k The diagonal.
+     */
+    void begin_diagonal(const long k) const {
+        instrumentation.begin_diagonal(k);
+        if (stream) stream->acquire(k);
+    }
+
+    /**
+     * \brief Pass a complete diagonal to the consumer of the stream, if any, and hint the storage that it is complete,
+     * when the matrix is in memory-mapped files.
+     * An element is only read by the elements on its right (as part of its row) and by the elements above it
+     * (as part of its column), so after diagonal k the row size - 1 - k of the matrix and the column k of the
+     * transposed matrix are never read again: they are dropped. The next diagonal starts reading both from their
+     * first rows again, so those are paged in ahead.
+     * \param k The diagonal.
+     */
+    void diagonal_done(const long k) const {
+        if (stream) stream->publish(k);
+
+        const long row = size - 1 - k;
+        data_storage.done(index(row, row), index(row, size - 1) + 1);
+        data_t_storage.done(transposed_index(k, first_row(k)), transposed_index(k, k) + 1);
+
+        if (k < diagonals) {
+            const long next = transposed_index(k + 1, first_row(k + 1));
+            data_storage.will_need(0, storage_readahead);
+            data_t_storage.will_need(next, next + storage_readahead);
+        }
+    }
+
+    /**
+     * \brief Hint the storage that a column of tiles is complete, when the matrix is in memory-mapped files.
+     * The columns of the transposed matrix are only read by the elements of the same column, so they are dropped.
+     * \param tile_column The column of tiles.
+     * \param tile_size The number of rows and columns of a tile.
+     */
+    void tile_column_done(const long tile_column, const long tile_size) const {
+        const long column_begin = tile_column * tile_size;
+        const long column_end = std::min(column_begin + tile_size, size);
+        data_t_storage.done(transposed_index(column_begin, 0), transposed_index(column_end, 0));
+    }
+
+    /**
+     * \brief Prefetch into the L3 cache the first elements of the row and of the column of the element of diagonal k
+     * that is prefetch_distance rows below (row, row + k), as set by the tuning profile.
+     * \param row The row of the element being computed.
+     * \param k The diagonal.
+     */
+    void prefetch_row(const long row, const long k) const {
+        const long next = row + tuning.prefetch_distance;
+        for (long j = 1; tuning.prefetch_distance > 0 && j <= 4 && next + j < size - k; ++j) {
+            _mm_prefetch(&data[index(next, next + j)], _MM_HINT_T2);
+            _mm_prefetch(&data_t[transposed_index(next + k, next + j - 1)], _MM_HINT_T2);
+        }
+    }
+
+    /**
+     * \brief Compute the partial dot product used by the element (row, column) of the upper diagonals.
+     * It sums data(row, m) * data(m + 1, column) for m in [first, last).
+     * \param row The row of the element.
+     * \param column The column of the element.
+     * \param first The first index of the partial sum.
+     * \param last The index past the last one of the partial sum.
+     * \return The partial dot product.
+     */
+    [[nodiscard]] double dot_product(const long row, const long column, const long first, const long last) const {
+        if (last <= first) return 0.0;
+
+        return dot_product_kernel<T>(&data[index(row, first)], &data_t[transposed_index(column, first + 1)],
+                                     last - first);
+    }
+
+    /**
+     * \brief Compute the part of the dot products of a band of diagonals that only reads the previous diagonals.
+     * The band covers the diagonals [k, k + band) of the row; all their elements share the row segment
+     * data(row, m) for m in [row + band - 1, row + k), so the strip kernel loads it once for all of them.
+     * \param row The row of the elements.
+     * \param k The first diagonal of the band (k >= band - 1).
+     * \param band The number of diagonals of the band (band <= strip_width).
+     * \param partial_sums The strip_width partial sums of the elements (row, row + k + s), s in [0, band).
+     */
+    void compute_strip(const long row, const long k, const long band, double* __restrict__ const partial_sums) const {
+        const long first = row + band - 1;
+        const long elements = std::min(band, size - k - row);
+
+        // The columns past the band or the matrix reuse the first one, their results are discarded
+        const T* columns[strip_width];
+        for (long s = 0; s < strip_width; ++s) {
+            columns[s] = &data_t[transposed_index(row + k + (s < elements ? s : 0), first + 1)];
+        }
+        dot_product_strip_kernel<T>(&data[index(row, first)], columns, k - band + 1, partial_sums);
+    }
+
+    /**
+     * \brief Compute the dot product of an element of a band of diagonals from its partial sum.
+     * The remaining terms are the ones that read the band itself, so the diagonals before k + s must be complete.
+     * \param row The row of the element.
+     * \param k The first diagonal of the band.
+     * \param s The diagonal of the element in the band, the element is (row, row + k + s).
+     * \param band The number of diagonals of the band.
+     * \param partial_sum The partial sum computed by compute_strip().
+     * \return The dot product of the element.
+     */
+    [[nodiscard]] double band_element_sum(const long row, const long k, const long s, const long band,
+                                          const double partial_sum) const {
+        const long column = row + k + s;
+        return dot_product(row, column, row, row + band - 1) + partial_sum + dot_product(row, column, row + k, column);
+    }
+
+    /**
+     * \brief Store a batch of consecutive elements of a diagonal, given their reductions.
+     * \param first_row The row of the first element.
+     * \param k The diagonal.
+     * \param sums The reductions of the elements, replaced with the elements (see Cell::finalize()).
+     * \param count The number of elements.
+     * \param cbrt_mode The accuracy of the cubic roots.
+     */
+    void store_diagonal(const long first_row, const long k, double* __restrict__ const sums, const long count,
+                        const CbrtMode cbrt_mode) const {
+        cell.finalize(sums, count, cbrt_mode);
+        for (long i = first_row; i < first_row + count; ++i) {
+            data[index(i, i + k)] = static_cast<T>(sums[i - first_row]);
+            data_t[transposed_index(i + k, i)] = static_cast<T>(sums[i - first_row]);
+        }
+
+        // The consumer of the stream reads the diagonal from its slot
+        if (!stream) return;
+        T* const diagonal = stream->slot(k);
+        for (long i = first_row; i < first_row + count; ++i) {
+            diagonal[i] = static_cast<T>(sums[i - first_row]);
+        }
+    }
+
+    /**
+     * \brief Compute a chunk of consecutive elements of a diagonal before the bands, with whole reductions.
+     * \param k The diagonal.
+     * \param first The row of the first element.
+     * \param last The row past the last element (at most cbrt_batch_size after the first one).
+     * \param cbrt_mode The accuracy of the cubic roots.
+     */
+    void compute_diagonal_chunk(const long k, const long first, const long last, const CbrtMode cbrt_mode) const {
+        double sums[cbrt_batch_size];
+        for (long i = first; i < last; ++i) {
+
+            // Prefetch the first elements of the row and column of a next iteration into L3 cache
+            prefetch_row(i, k);
+
+            // Reduction of the row and column, the SIMD dot product kernel selected at startup by default
+            sums[i - first] = cell.reduce(&data[index(i, i)], &data_t[transposed_index(i + k, i + 1)], i, i + k);
+        }
+
+        // Store the finalized chunk in the current diagonal
+        store_diagonal(first, k, sums, last - first, cbrt_mode);
+    }
+
+    /**
+     * \brief Compute the partial sums of a chunk of rows for a band of diagonals (see compute_strip()).
+     * \param k The first diagonal of the band.
+     * \param band The number of diagonals of the band.
+     * \param first The first row.
+     * \param last The row past the last one.
+     * \param partial_sums The partial sums of the band, strip_width per row.
+     */
+    void compute_strips(const long k, const long band, const long first, const long last,
+                        double* __restrict__ const partial_sums) const {
+        for (long i = first; i < last; ++i) {
+            compute_strip(i, k, band, &partial_sums[i * strip_width]);
+        }
+    }
+
+    /**
+     * \brief Compute a chunk of consecutive elements of a diagonal of a band, from their partial sums.
+     * \param k The first diagonal of the band.
+     * \param s The diagonal in the band.
+     * \param band The number of diagonals of the band.
+     * \param first The row of the first element.
+     * \param last The row past the last element (at most cbrt_batch_size after the first one).
+     * \param partial_sums The partial sums of the band, strip_width per row (see compute_strips()).
+     * \param cbrt_mode The accuracy of the cubic roots.
+     */
+    void compute_band_chunk(const long k, const long s, const long band, const long first, const long last,
+                            const double* __restrict__ const partial_sums, const CbrtMode cbrt_mode) const {
+        double sums[cbrt_batch_size];
+        for (long i = first; i < last; ++i) {
+            sums[i - first] = band_element_sum(i, k, s, band, partial_sums[i * strip_width + s]);
+        }
+        store_diagonal(first, k + s, sums, last - first, cbrt_mode);
+    }
+
+    /**
+     * \brief Compute all the elements of a tile of the upper triangle.
+     * The tile (tile_row, tile_column) covers the rows [tile_row * tile_size, (tile_row + 1) * tile_size) and the
+     * columns [tile_column * tile_size, (tile_column + 1) * tile_size), clipped to the upper triangle.
+     * All the tiles on its left and below it must already be computed.
+     *
+     * The dot product of each element is split in three ranges of m:
+     * the middle one only reads tiles that are already complete, so it is accumulated block by block for the whole tile
+     * (reusing the same row and column segments from cache across the tile, and each row segment from registers across
+     * a strip of columns), while the head and the tail read the
+     * elements of the tile itself, so they are added in dependency order (columns left to right, rows bottom to top).
+     * \param tile_row The row of the tile.
+     * \param tile_column The column of the tile (tile_column >= tile_row).
+     * \param tile_size The number of rows and columns of a tile.
+     * \param partial_sums A scratch buffer of at least tile_size * tile_size elements.
+     */
+    void compute_tile(const long tile_row, const long tile_column, const long tile_size,
+                      double* __restrict__ const partial_sums) const {
+        static_assert(Cell::sum_of_products, "The tiles split the reductions in partial dot products");
+        const long row_begin = tile_row * tile_size;
+        const long row_end = std::min(row_begin + tile_size, size);
+        const long column_begin = tile_column * tile_size;
+        const long column_end = std::min(column_begin + tile_size, size);
+        const long columns = column_end - column_begin;
+
+        // Range of m where both data(i, m) and data(m + 1, j) belong to already computed tiles
+        const long middle_begin = row_end;
+        const long middle_end = column_begin - 1;
+
+        if (middle_begin < middle_end) {
+            std::fill(partial_sums, partial_sums + (row_end - row_begin) * columns, 0.0);
+            for (long m = middle_begin; m < middle_end; m += tile_size) {
+                const long m_end = std::min(m + tile_size, middle_end);
+                for (long i = row_begin; i < row_end; ++i) {
+                    double* __restrict__ const row_sums = &partial_sums[(i - row_begin) * columns];
+
+                    // Strips of strip_width columns share the row segment, the last one reuses its first column
+                    for (long j = column_begin; j < column_end; j += strip_width) {
+                        const long elements = std::min(strip_width, column_end - j);
+                        const T* strip_columns[strip_width];
+                        for (long s = 0; s < strip_width; ++s) {
+                            strip_columns[s] = &data_t[transposed_index(j + (s < elements ? s : 0), m + 1)];
+                        }
+
+                        double sums[strip_width];
+                        dot_product_strip_kernel<T>(&data[index(i, m)], strip_columns, m_end - m, sums);
+                        for (long s = 0; s < elements; ++s) {
+                            row_sums[j - column_begin + s] += sums[s];
+                        }
+                    }
+                }
+            }
+        }
+
+        for (long j = column_begin; j < column_end; ++j) {
+            const long head_end = std::min(middle_begin, j);
+            const long tail_begin = std::max(middle_end, head_end);
+
+            for (long i = std::min(row_end, j) - 1; i >= row_begin; --i) {
+                double sum = dot_product(i, j, i, head_end);
+                if (middle_begin < middle_end) {
+                    sum += partial_sums[(i - row_begin) * columns + j - column_begin];
+                }
+                sum += dot_product(i, j, tail_begin, j);
+
+                // Store the result in the current tile
+                cell.finalize(&sum, 1, CbrtMode::Exact);
+                const auto value = static_cast<T>(sum);
+                data[index(i, j)] = value;
+                data_t[transposed_index(j, i)] = value;
+            }
+        }
+    }
+
 };
 
 #endif //SPM_MATRIX_H
\ No newline at end of file
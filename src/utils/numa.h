@@ -0,0 +1,190 @@
+#ifndef SPM_NUMA_H
+#define SPM_NUMA_H
+
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * \brief The placement of the pages of a matrix on the NUMA nodes, and of the rows on the workers.
+ */
+enum class NumaPolicy {
+    Default, ///< The pages are placed by the first worker that writes them, the workers are not pinned.
+    FirstTouch, ///< Each worker is pinned to a core and writes first the pages of the rows it owns.
+    Interleave, ///< The pages are interleaved on all the nodes, the workers are pinned.
+    Bind ///< The pages of the rows of each worker are bound to the node of its core, the workers are pinned.
+};
+
+/**
+ * \brief Get the name of a NUMA policy.
+ * \param policy The policy.
+ * \return The name of the policy.
+ */
+inline std::string to_string(const NumaPolicy policy) {
+    switch (policy) {
+        case NumaPolicy::FirstTouch: return "first-touch";
+        case NumaPolicy::Interleave: return "interleave";
+        case NumaPolicy::Bind: return "bind";
+        default: return "default";
+    }
+}
+
+/**
+ * \brief Parse a NUMA policy: default, first-touch, interleave or bind.
+ * \param name The name of the policy.
+ * \param policy The parsed policy.
+ * \return true if the name is a valid policy, false otherwise.
+ */
+inline bool parse_numa_policy(const std::string& name, NumaPolicy& policy) {
+    if (name == "default") {
+        policy = NumaPolicy::Default;
+    } else if (name == "first-touch") {
+        policy = NumaPolicy::FirstTouch;
+    } else if (name == "interleave") {
+        policy = NumaPolicy::Interleave;
+    } else if (name == "bind") {
+        policy = NumaPolicy::Bind;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/**
+ * \brief The NUMA nodes of the machine and their cores, read from /sys/devices/system/node.
+ * Without NUMA support, all the cores are on node 0.
+ */
+class NumaTopology {
+
+public:
+
+    /**
+     * \brief Get the topology of the machine, read the first time.
+     * \return The topology.
+     */
+    static const NumaTopology& get() {
+        static const NumaTopology topology;
+        return topology;
+    }
+
+    /**
+     * \brief Get the number of nodes.
+     * \return The number of nodes with cores.
+     */
+    [[nodiscard]] int nodes() const {
+        return static_cast<int>(node_cores.size());
+    }
+
+    /**
+     * \brief Get the nodes with cores.
+     * \return The nodes.
+     */
+    [[nodiscard]] const std::vector<int>& node_list() const {
+        return node_ids;
+    }
+
+    /**
+     * \brief Get the core of a worker. The workers are spread over the nodes in round-robin order,
+     * so that few workers already use the memory bandwidth of all the nodes.
+     * \param worker The index of the worker.
+     * \return The core of the worker.
+     */
+    [[nodiscard]] int core(const long worker) const {
+        const std::vector<int>& cores = node_cores[worker % nodes()];
+        return cores[(worker / nodes()) % static_cast<long>(cores.size())];
+    }
+
+    /**
+     * \brief Get the node of a worker, the one of its core.
+     * \param worker The index of the worker.
+     * \return The node of the worker.
+     */
+    [[nodiscard]] int node(const long worker) const {
+        return node_ids[worker % nodes()];
+    }
+
+private:
+
+    std::vector<int> node_ids; ///< The nodes with cores.
+    std::vector<std::vector<int>> node_cores; ///< The cores of each node.
+
+    /**
+     * \brief Constructor to read the topology.
+     */
+    NumaTopology() {
+        const std::filesystem::path root{"/sys/devices/system/node"};
+        std::error_code error;
+        for (int node = 0; std::filesystem::exists(root / ("node" + std::to_string(node)), error); ++node) {
+            std::ifstream file{root / ("node" + std::to_string(node)) / "cpulist"};
+            std::string list;
+            std::getline(file, list);
+            std::vector<int> cores = parse_cpulist(list);
+            if (cores.empty()) continue;
+            node_ids.push_back(node);
+            node_cores.push_back(std::move(cores));
+        }
+
+        if (node_cores.empty()) {
+            node_ids.push_back(0);
+            node_cores.emplace_back();
+            for (int core = 0; core < static_cast<int>(std::max(1u, std::thread::hardware_concurrency())); ++core) {
+                node_cores.back().push_back(core);
+            }
+        }
+    }
+
+    /**
+     * \brief Parse a list of cores, such as "0-3,8-11".
+     * \param list The list.
+     * \return The cores of the list.
+     */
+    static std::vector<int> parse_cpulist(const std::string& list) {
+        std::vector<int> cores;
+        std::istringstream stream{list};
+        std::string range;
+        while (std::getline(stream, range, ',')) {
+            const std::size_t dash = range.find('-');
+            try {
+                const int first = std::stoi(range.substr(0, dash));
+                const int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+                for (int core = first; core <= last; ++core) {
+                    cores.push_back(core);
+                }
+            } catch ([[maybe_unused]] const std::logic_error& e) {
+                return {};
+            }
+        }
+        return cores;
+    }
+
+};
+
+/**
+ * \brief Set the memory policy of a range of pages, moving the pages already in memory.
+ * The policy is a hint: it is silently ignored if the kernel does not support it.
+ * \param address The first page of the range.
+ * \param bytes The size of the range in bytes.
+ * \param mode The policy (MPOL_BIND or MPOL_INTERLEAVE).
+ * \param nodes The nodes of the policy.
+ */
+inline void set_memory_policy(void* const address, const std::size_t bytes, const int mode,
+                              const std::vector<int>& nodes) {
+    constexpr int bits = 8 * sizeof(unsigned long);
+    const int max_node = *std::max_element(nodes.begin(), nodes.end());
+    std::vector<unsigned long> mask(max_node / bits + 1, 0UL);
+    for (const int node : nodes) {
+        mask[node / bits] |= 1UL << (node % bits);
+    }
+    syscall(SYS_mbind, address, bytes, mode, mask.data(), max_node + 2, MPOL_MF_MOVE);
+}
+
+#endif //SPM_NUMA_H
\ No newline at end of file
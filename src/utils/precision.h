@@ -0,0 +1,41 @@
+#ifndef SPM_PRECISION_H
+#define SPM_PRECISION_H
+
+#include <string>
+
+/**
+ * \brief The type of the stored elements of a matrix.
+ * The dot products and the cubic roots are computed in double precision in both cases.
+ */
+enum class Precision {
+    Double, ///< The elements are stored as double.
+    Float ///< The elements are stored as float, halving the memory, the bandwidth and the MPI messages.
+};
+
+/**
+ * \brief Get the name of a precision.
+ * \param precision The precision.
+ * \return The name of the precision.
+ */
+inline std::string to_string(const Precision precision) {
+    return precision == Precision::Float ? "float" : "double";
+}
+
+/**
+ * \brief Parse a precision: double or float.
+ * \param name The name of the precision.
+ * \param precision The parsed precision.
+ * \return true if the name is a valid precision, false otherwise.
+ */
+inline bool parse_precision(const std::string& name, Precision& precision) {
+    if (name == "double") {
+        precision = Precision::Double;
+    } else if (name == "float") {
+        precision = Precision::Float;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+#endif //SPM_PRECISION_H
\ No newline at end of file
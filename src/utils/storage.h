@@ -0,0 +1,231 @@
+#ifndef SPM_STORAGE_H
+#define SPM_STORAGE_H
+
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <mm_malloc.h>
+
+#include "buffer_pool.h"
+#include "numa.h"
+
+/**
+ * \brief The number of elements hinted as needed soon at the start of each stream of a diagonal (8 MiB).
+ */
+constexpr long storage_readahead = 1L << 20;
+
+/**
+ * \brief The size in bytes from which the buffers come from the buffer pool (1 MiB), the smaller ones are allocated.
+ */
+constexpr std::size_t pooled_bytes = 1UL << 20;
+
+/**
+ * \brief A buffer of elements for the packed triangles of a matrix.
+ * By default a large buffer comes from the BufferPool, backed by huge pages and already faulted in, and a small one
+ * is allocated in aligned memory. When the SPM_STORAGE environment variable names a directory,
+ * it is a memory-mapped temporary file in that directory instead, so that matrices larger than the memory can be
+ * computed: the operating system pages the buffer in and out, guided by the hints of will_need() and done().
+ * \tparam T The type of the elements.
+ */
+template <typename T = double>
+class Storage {
+
+public:
+
+    /**
+     * \brief Constructor.
+     * \param count The number of elements of the buffer (0 means no buffer).
+     * \param pool Whether a large buffer can come from the pool, otherwise it is allocated and its pages are placed
+     * by the first thread that writes them (default is true).
+     */
+    explicit Storage(const long count, const bool pool = true) :
+    bytes{static_cast<std::size_t>(count) * sizeof(T)},
+    mapped{count > 0 && directory() != nullptr},
+    pooled{count > 0 && !mapped && pool && bytes >= pooled_bytes},
+    buffer{count <= 0 ? nullptr : mapped ? map_file(directory(), bytes)
+                                : pooled ? static_cast<T*>(BufferPool::get().acquire(bytes))
+                                : static_cast<T*>(_mm_malloc(bytes, 32))}
+    {
+        if (mapped) {
+            // The diagonal sweeps read each row and column from the first element onwards
+            madvise(buffer, bytes, MADV_SEQUENTIAL);
+        }
+    }
+
+    Storage(const Storage&) = delete;
+    Storage& operator=(const Storage&) = delete;
+
+    /**
+     * \brief Destructor to unmap or free the buffer, or to give it back to the pool.
+     */
+    ~Storage() {
+        if (mapped) {
+            munmap(buffer, bytes);
+        } else if (pooled) {
+            BufferPool::get().release(buffer);
+        } else if (buffer) {
+            _mm_free(buffer);
+        }
+    }
+
+    /**
+     * \brief Get the buffer.
+     * \return The first element of the buffer.
+     */
+    [[nodiscard]] T* get() const {
+        return buffer;
+    }
+
+    /**
+     * \brief Hint that a range of elements is going to be read soon, so that it is paged in ahead of time.
+     * It does nothing if the buffer is not mapped.
+     * \param first The first element of the range.
+     * \param last The element past the last one of the range (clipped to the buffer).
+     */
+    void will_need(const long first, const long last) const {
+        if (!mapped) return;
+
+        // Extend the range to whole pages
+        const std::size_t begin = align_down(static_cast<std::size_t>(first) * sizeof(T));
+        const std::size_t end = std::min(static_cast<std::size_t>(last) * sizeof(T), bytes);
+        if (begin < end) {
+            madvise(reinterpret_cast<char*>(buffer) + begin, end - begin, MADV_WILLNEED);
+        }
+    }
+
+    /**
+     * \brief Hint that a range of elements is complete and is not going to be read again by the computation,
+     * so that its pages can be written back and dropped from the memory of the process.
+     * The elements keep their values (they are read back from the file if they are accessed).
+     * It does nothing if the buffer is not mapped.
+     * \param first The first element of the range.
+     * \param last The element past the last one of the range.
+     */
+    void done(const long first, const long last) const {
+        if (!mapped) return;
+
+        // Shrink the range to whole pages, the pages at the ends may still be in use
+        const std::size_t begin = align_down(static_cast<std::size_t>(first) * sizeof(T) + page_size() - 1);
+        const std::size_t end = align_down(static_cast<std::size_t>(last) * sizeof(T));
+        if (begin < end) {
+            madvise(reinterpret_cast<char*>(buffer) + begin, end - begin, MADV_DONTNEED);
+        }
+    }
+
+    /**
+     * \brief Bind the pages of a range of elements to a NUMA node, moving the ones already in memory.
+     * Each page belongs to the range that contains its first byte, so that adjacent ranges split the pages.
+     * It does nothing if the buffer is mapped.
+     * \param first The first element of the range.
+     * \param last The element past the last one of the range.
+     * \param node The node.
+     */
+    void bind(const long first, const long last, const int node) const {
+        if (mapped || buffer == nullptr) return;
+
+        const auto address = reinterpret_cast<std::size_t>(buffer);
+        const std::size_t begin = align_up(address + static_cast<std::size_t>(first) * sizeof(T));
+        const std::size_t end = align_up(address + std::min(static_cast<std::size_t>(last) * sizeof(T), bytes));
+        if (begin < end) {
+            set_memory_policy(reinterpret_cast<void*>(begin), end - begin, MPOL_BIND, {node});
+        }
+    }
+
+    /**
+     * \brief Interleave the pages of the buffer on NUMA nodes. It does nothing if the buffer is mapped.
+     * \param nodes The nodes.
+     */
+    void interleave(const std::vector<int>& nodes) const {
+        if (mapped || buffer == nullptr) return;
+
+        const auto address = reinterpret_cast<std::size_t>(buffer);
+        const std::size_t begin = align_up(address);
+        const std::size_t end = align_up(address + bytes);
+        if (begin < end) {
+            set_memory_policy(reinterpret_cast<void*>(begin), end - begin, MPOL_INTERLEAVE, nodes);
+        }
+    }
+
+private:
+
+    const std::size_t bytes; ///< The size of the buffer in bytes.
+    const bool mapped; ///< Whether the buffer is a memory-mapped file.
+    const bool pooled; ///< Whether the buffer comes from the pool.
+    T* const buffer; ///< The buffer.
+
+    /**
+     * \brief Get the directory of the memory-mapped files.
+     * \return The value of SPM_STORAGE, or nullptr if it is not set (or empty).
+     */
+    static const char* directory() {
+        const char* const directory = std::getenv("SPM_STORAGE");
+        return directory != nullptr && *directory != '\0' ? directory : nullptr;
+    }
+
+    /**
+     * \brief Get the size of a page.
+     * \return The size of a page in bytes.
+     */
+    static std::size_t page_size() {
+        static const auto size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+        return size;
+    }
+
+    /**
+     * \brief Round an offset down to a page boundary.
+     * \param offset The offset in bytes.
+     * \return The offset of the page that contains it.
+     */
+    static std::size_t align_down(const std::size_t offset) {
+        return offset / page_size() * page_size();
+    }
+
+    /**
+     * \brief Round an offset up to a page boundary.
+     * \param offset The offset in bytes.
+     * \return The offset of the first page that starts at or after it.
+     */
+    static std::size_t align_up(const std::size_t offset) {
+        return align_down(offset + page_size() - 1);
+    }
+
+    /**
+     * \brief Create a temporary file in a directory and map it in memory.
+     * The file is removed right away, so that it disappears with the mapping. It is sparse: the pages that are never
+     * written do not take any space.
+     * \param directory The directory of the file.
+     * \param bytes The size of the file in bytes.
+     * \return The mapping of the file.
+     */
+    static T* map_file(const std::string& directory, const std::size_t bytes) {
+        std::string path = directory + "/spm-XXXXXX";
+        const int fd = mkstemp(path.data());
+        if (fd < 0) {
+            throw std::runtime_error("Could not create a file in " + directory + ": " + std::strerror(errno));
+        }
+        unlink(path.c_str());
+
+        if (ftruncate(fd, static_cast<off_t>(bytes)) != 0) {
+            const int error = errno;
+            close(fd);
+            throw std::runtime_error("Could not resize " + path + ": " + std::strerror(error));
+        }
+
+        void* const mapping = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        const int error = errno;
+        close(fd);
+        if (mapping == MAP_FAILED) {
+            throw std::runtime_error("Could not map " + path + ": " + std::strerror(error));
+        }
+        return static_cast<T*>(mapping);
+    }
+
+};
+
+#endif //SPM_STORAGE_H
\ No newline at end of file
@@ -0,0 +1,238 @@
+#ifndef SPM_TRIANGLE_FILE_H
+#define SPM_TRIANGLE_FILE_H
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+/**
+ * \brief The header of a binary file of the packed upper triangle of a matrix.
+ * The header takes the first triangle_data_offset bytes of the file, the rest are zeros; then come the elements,
+ * row by row as in the data buffer of the matrix, in the byte order of the machine.
+ */
+struct TriangleHeader {
+    char magic[8]; ///< The identifier of the format, triangle_magic.
+    std::uint64_t size; ///< The size of the matrix (number of rows and columns).
+    std::uint64_t element_size; ///< The size in bytes of an element: 4 for float, 8 for double.
+    double checksum; ///< The sum of the elements, as Matrix::checksum().
+};
+
+/**
+ * \brief The identifier of the format of the binary files of the triangles.
+ */
+constexpr char triangle_magic[8] = {'S', 'P', 'M', 'T', 'R', 'I', '1', '\0'};
+
+/**
+ * \brief The offset of the elements in a binary file of a triangle, a page so that they can be mapped in place.
+ */
+constexpr std::size_t triangle_data_offset = 4096;
+
+/**
+ * \brief Get the header of a binary file of a triangle.
+ * \tparam T The type of the elements.
+ * \param size The size of the matrix.
+ * \param checksum The sum of the elements.
+ * \return The header.
+ */
+template <typename T>
+TriangleHeader triangle_header(const long size, const double checksum) {
+    TriangleHeader header{};
+    std::copy(std::begin(triangle_magic), std::end(triangle_magic), header.magic);
+    header.size = static_cast<std::uint64_t>(size);
+    header.element_size = sizeof(T);
+    header.checksum = checksum;
+    return header;
+}
+
+/**
+ * \brief Get the number of elements of the packed upper triangle of a matrix.
+ * \param size The size of the matrix.
+ * \return The number of elements.
+ */
+inline long triangle_elements(const long size) {
+    return size * (size + 1) / 2;
+}
+
+/**
+ * \brief Write a buffer at an offset of a file, in pieces of at most 1 GiB.
+ * \param fd The file descriptor.
+ * \param buffer The buffer.
+ * \param bytes The size of the buffer in bytes.
+ * \param offset The offset in the file.
+ * \param path The path of the file, for the errors.
+ * \throw std::runtime_error if the buffer cannot be written.
+ */
+inline void write_fully(const int fd, const void* const buffer, const std::size_t bytes, const std::size_t offset,
+                        const std::string& path) {
+    const auto* const bytes_buffer = static_cast<const char*>(buffer);
+    for (std::size_t written = 0; written < bytes;) {
+        const ssize_t result = pwrite(fd, bytes_buffer + written, std::min(bytes - written, std::size_t{1} << 30),
+                                      static_cast<off_t>(offset + written));
+        if (result < 0 && errno == EINTR) continue;
+        if (result <= 0) {
+            throw std::runtime_error("Could not write " + path + ": " + std::strerror(errno));
+        }
+        written += static_cast<std::size_t>(result);
+    }
+}
+
+/**
+ * \brief Write the packed upper triangle of a matrix in a binary file (see TriangleHeader), as raw bytes.
+ * \tparam T The type of the elements.
+ * \param path The path of the file, replaced if it exists.
+ * \param size The size of the matrix.
+ * \param data The packed upper triangle, triangle_elements(size) elements.
+ * \param checksum The sum of the elements.
+ * \throw std::runtime_error if the file cannot be written.
+ */
+template <typename T>
+void write_triangle(const std::string& path, const long size, const T* const data, const double checksum) {
+    const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Could not open " + path + ": " + std::strerror(errno));
+    }
+
+    try {
+        // The file takes its whole length first, so that it is complete even without elements to write
+        const std::size_t bytes = static_cast<std::size_t>(triangle_elements(size)) * sizeof(T);
+        if (ftruncate(fd, static_cast<off_t>(triangle_data_offset + bytes)) != 0) {
+            throw std::runtime_error("Could not write " + path + ": " + std::strerror(errno));
+        }
+        const TriangleHeader header = triangle_header<T>(size, checksum);
+        write_fully(fd, &header, sizeof(header), 0, path);
+        write_fully(fd, data, bytes, triangle_data_offset, path);
+    } catch (...) {
+        close(fd);
+        throw;
+    }
+    if (close(fd) != 0) {
+        throw std::runtime_error("Could not write " + path + ": " + std::strerror(errno));
+    }
+}
+
+/**
+ * \brief A binary file of the packed upper triangle of a matrix (see write_triangle()), mapped read-only in memory:
+ * the elements are read in place, paged in by the operating system when they are accessed.
+ * \tparam T The type of the elements, the one of the matrix that was written.
+ */
+template <typename T = double>
+class TriangleFile {
+
+public:
+
+    /**
+     * \brief Constructor to map a file.
+     * \param path The path of the file.
+     * \throw std::runtime_error if the file cannot be mapped, or it is not a triangle of elements of type T.
+     */
+    explicit TriangleFile(const std::string& path) {
+        const int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Could not open " + path + ": " + std::strerror(errno));
+        }
+
+        struct stat status{};
+        TriangleHeader header{};
+        const bool valid = fstat(fd, &status) == 0 &&
+                           pread(fd, &header, sizeof(header), 0) == static_cast<ssize_t>(sizeof(header)) &&
+                           std::equal(std::begin(triangle_magic), std::end(triangle_magic), header.magic);
+        if (!valid) {
+            close(fd);
+            throw std::runtime_error("Not a triangle file: " + path);
+        }
+        if (header.element_size != sizeof(T)) {
+            close(fd);
+            throw std::runtime_error("The elements of " + path + " have " + std::to_string(header.element_size) +
+                                     " bytes, not " + std::to_string(sizeof(T)));
+        }
+
+        file_size = static_cast<long>(header.size);
+        stored_checksum = header.checksum;
+        bytes = triangle_data_offset + static_cast<std::size_t>(triangle_elements(file_size)) * sizeof(T);
+        if (static_cast<std::size_t>(status.st_size) < bytes) {
+            close(fd);
+            throw std::runtime_error("Truncated triangle file: " + path);
+        }
+
+        mapping = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+        const int error = errno;
+        close(fd);
+        if (mapping == MAP_FAILED) {
+            throw std::runtime_error("Could not map " + path + ": " + std::strerror(error));
+        }
+        madvise(mapping, bytes, MADV_SEQUENTIAL);
+    }
+
+    TriangleFile(const TriangleFile&) = delete;
+    TriangleFile& operator=(const TriangleFile&) = delete;
+
+    /**
+     * \brief Destructor to unmap the file.
+     */
+    ~TriangleFile() {
+        munmap(mapping, bytes);
+    }
+
+    /**
+     * \brief Get the size of the matrix.
+     * \return The number of rows and columns.
+     */
+    [[nodiscard]] long size() const {
+        return file_size;
+    }
+
+    /**
+     * \brief Get the packed upper triangle, in place in the mapping.
+     * \return The first element, the others follow row by row.
+     */
+    [[nodiscard]] const T* data() const {
+        return reinterpret_cast<const T*>(static_cast<const char*>(mapping) + triangle_data_offset);
+    }
+
+    /**
+     * \brief Get an element of the upper triangle.
+     * \param row The row of the element.
+     * \param column The column of the element (column >= row).
+     * \return The element, widened to double.
+     */
+    [[nodiscard]] double get(const long row, const long column) const {
+        return data()[row * (2 * file_size - row + 1) / 2 + column - row];
+    }
+
+    /**
+     * \brief Get the checksum recorded when the file was written.
+     * \return The sum of the elements.
+     */
+    [[nodiscard]] double checksum() const {
+        return stored_checksum;
+    }
+
+    /**
+     * \brief Check that the elements match the recorded checksum, reading all of them.
+     * \return true if their sum, in the same order as Matrix::checksum(), is the recorded one.
+     */
+    [[nodiscard]] bool verify() const {
+        double sum = 0.0;
+        for (long e = 0; e < triangle_elements(file_size); ++e) {
+            sum += data()[e];
+        }
+        return sum == stored_checksum;
+    }
+
+private:
+
+    long file_size = 0; ///< The size of the matrix.
+    double stored_checksum = 0.0; ///< The checksum recorded in the header.
+    std::size_t bytes = 0; ///< The size of the mapping in bytes.
+    void* mapping = nullptr; ///< The mapping of the file, header included.
+
+};
+
+#endif //SPM_TRIANGLE_FILE_H
\ No newline at end of file
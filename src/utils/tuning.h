@@ -0,0 +1,139 @@
+#ifndef SPM_TUNING_H
+#define SPM_TUNING_H
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include "cbrt.h"
+
+/**
+ * \brief The kernel settings of the matrices, tuned for a size of matrix on a machine (see the autotune target).
+ */
+struct TuningSettings {
+    long prefetch_distance = 1; ///< The number of rows ahead to prefetch in the dot product loops (0 disables it).
+    long workers = 0; ///< The number of FastFlow workers when none is given (0 means all the cores).
+    long chunk = cbrt_batch_size; ///< The largest number of rows of a batch of cubic roots (at most cbrt_batch_size).
+    long tile_size = 64; ///< The number of rows and columns of a tile when none is given.
+};
+
+/**
+ * \brief The path of the tuning profile, set with the SPM_TUNING_PROFILE environment variable.
+ * \return The path, tuning_profile.txt in the working directory if it is not set.
+ */
+inline std::string tuning_profile_path() {
+    const char* const value = std::getenv("SPM_TUNING_PROFILE");
+    return value != nullptr && *value != '\0' ? value : "tuning_profile.txt";
+}
+
+/**
+ * \brief The tuned settings of the process, one per tuned size of matrix, read from the tuning profile the first
+ * time they are needed. A matrix uses the settings of the largest tuned size not larger than its own (or of the
+ * smallest tuned size), and the default ones without a profile.
+ *
+ * The profile is a text file with one line per tuned size: the size, the prefetch distance, the number of workers,
+ * the chunk and the tile size, separated by spaces. The lines starting with # are comments.
+ */
+class TuningProfile {
+
+public:
+
+    /**
+     * \brief Get the profile of the process, read from tuning_profile_path() the first time.
+     * It can be changed before constructing the matrices (see the autotuner).
+     * \return The profile.
+     */
+    static TuningProfile& get() {
+        static TuningProfile profile{tuning_profile_path()};
+        return profile;
+    }
+
+    /**
+     * \brief Constructor to read a profile, empty if the file does not exist.
+     * \param path The path of the profile.
+     * \throw std::runtime_error if the file is not a valid profile.
+     */
+    explicit TuningProfile(const std::string& path) {
+        std::ifstream file{path};
+        std::string line;
+        while (std::getline(file, line)) {
+            if (line.empty() || line[0] == '#') continue;
+
+            std::istringstream stream{line};
+            long size;
+            TuningSettings tuned;
+            if (!(stream >> size >> tuned.prefetch_distance >> tuned.workers >> tuned.chunk >> tuned.tile_size) ||
+                size <= 0 || tuned.prefetch_distance < 0 || tuned.workers < 0 || tuned.chunk <= 0 ||
+                tuned.chunk > cbrt_batch_size || tuned.tile_size <= 0) {
+                throw std::runtime_error("Invalid tuning profile " + path + ": " + line);
+            }
+            entries[size] = tuned;
+        }
+    }
+
+    /**
+     * \brief Get the settings of a size of matrix.
+     * \param size The size of the matrix.
+     * \return The settings of the largest tuned size not larger than size, or of the smallest tuned size.
+     */
+    [[nodiscard]] TuningSettings settings(const long size) const {
+        if (entries.empty()) return {};
+
+        const auto next = entries.upper_bound(size);
+        return next == entries.begin() ? next->second : std::prev(next)->second;
+    }
+
+    /**
+     * \brief Set the settings of a size of matrix, for the matrices constructed from now on.
+     * \param size The size of the matrix.
+     * \param tuned The settings.
+     */
+    void set(const long size, const TuningSettings& tuned) {
+        entries[size] = tuned;
+    }
+
+    /**
+     * \brief Write the profile.
+     * \param path The path of the profile.
+     * \throw std::runtime_error if the file cannot be written.
+     */
+    void write(const std::string& path) const {
+        std::ofstream file{path};
+        if (!file.is_open()) {
+            throw std::runtime_error("Could not open file");
+        }
+
+        file << "# size prefetch_distance workers chunk tile_size\n";
+        for (const auto& [size, tuned] : entries) {
+            file << size << " " << tuned.prefetch_distance << " " << tuned.workers << " " << tuned.chunk << " "
+                 << tuned.tile_size << "\n";
+        }
+    }
+
+private:
+
+    std::map<long, TuningSettings> entries; ///< The settings of each tuned size.
+
+};
+
+/**
+ * \brief Read the tuning profile of the process, so that the drivers validate it before constructing any matrix.
+ * \param verbose Whether to print the error if the profile is not valid (only one process of MPI prints it).
+ * \return true if the profile is valid or there is none, false otherwise.
+ */
+inline bool load_tuning_profile(const bool verbose = true) {
+    try {
+        TuningProfile::get();
+        return true;
+    } catch (const std::runtime_error& error) {
+        if (verbose) std::cerr << error.what() << std::endl;
+        return false;
+    }
+}
+
+#endif //SPM_TUNING_H
\ No newline at end of file
@@ -0,0 +1,32 @@
+#include "src/fastflow/autotune.h"
+#include "src/utils/tuning.h"
+#include <iostream>
+#include <string>
+
+int main(int argc, char *argv[]) {
+
+    // The sizes of the range to tune, each one with the median of a few runs
+    BenchmarkOptions options;
+    options.dimensions = {1024, 2048, 4096};
+    options.repetitions = 3;
+    if (!parse_benchmark_options(argc, argv, options) || argc > 2) {
+        std::cerr << "Usage: " << argv[0] << " [profile] " << benchmark_usage << std::endl;
+        return 1;
+    }
+    if (options.save) {
+        std::cerr << "Invalid argument: the autotuner does not save its matrices." << std::endl;
+        return 1;
+    }
+    if (options.diagonals > 0) {
+        std::cerr << "Invalid argument: the autotuner times the sweeps of the whole upper triangle, not of a band."
+                  << std::endl;
+        return 1;
+    }
+    if (!load_tuning_profile()) {
+        return 1;
+    }
+    const std::string path = argc > 1 ? argv[1] : tuning_profile_path();
+
+    return autotune(path, options) ? 0 : 1;
+
+}
@@ -0,0 +1,41 @@
+#include "src/fastflow/batch.h"
+#include "src/utils/cli.h"
+#include <iostream>
+#include <string>
+
+int main(int argc, char *argv[]) {
+
+    // Batches are made of many small and medium matrices
+    BenchmarkOptions options;
+    options.dimensions = {256, 512, 1024, 2048};
+    if (!parse_benchmark_options(argc, argv, options) || argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <num_workers> <num_matrices> [parallel_size [double|float]] "
+                  << benchmark_usage << std::endl;
+        return 1;
+    }
+    if (options.save) {
+        std::cerr << "Invalid argument: the batches do not save their matrices." << std::endl;
+        return 1;
+    }
+    if (!load_tuning_profile()) {
+        return 1;
+    }
+    long maxnw;
+    long count;
+    long parallel_size = 4096;
+    Precision precision = Precision::Double;
+
+    if (!parseLong(argv[1], maxnw) || !parseLong(argv[2], count)) {
+        return 1;
+    }
+    if (argc > 3 && !parseLong(argv[3], parallel_size)) {
+        return 1;
+    }
+    if (argc > 4 && !parse_precision(argv[4], precision)) {
+        std::cerr << "Invalid argument: " << argv[4] << " is not a valid precision." << std::endl;
+        return 1;
+    }
+
+    return test_batch(maxnw, count, parallel_size, precision, options) ? 0 : 1;
+
+}
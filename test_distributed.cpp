@@ -1,4 +1,5 @@
 #include <mpi.h>
+#include <iostream>
 
 #include "src/mpi/distributed.h"
 
@@ -10,9 +11,28 @@ int main(int argc, char *argv[]) {
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &mpi_size);
 
-    test_distributed(rank, mpi_size);
+    Partitioning partitioning = Partitioning::Block;
+    int cyclic_block = 1;
+    Precision precision = Precision::Double;
+    BenchmarkOptions options;
+    if (!parse_benchmark_options(argc, argv, options) ||
+        (argc > 1 && !parse_partitioning(argv[1], partitioning, cyclic_block)) ||
+        (argc > 2 && !parse_precision(argv[2], precision))) {
+        if (rank == 0)
+            std::cerr << "Usage: " << argv[0]
+                      << " [block|cyclic[:<rows per block>]|rebalanced|distributed [double|float]] "
+                      << benchmark_usage << std::endl;
+        MPI_Finalize();
+        return 1;
+    }
+    if (!load_tuning_profile(rank == 0)) {
+        MPI_Finalize();
+        return 1;
+    }
+
+    const bool valid = test_distributed(rank, mpi_size, partitioning, cyclic_block, precision, options);
 
     MPI_Finalize();
 
-    return 0;
-}
\ No newline at end of file
+    return valid ? 0 : 1;
+}
@@ -0,0 +1,46 @@
+#include <mpi.h>
+#include <iostream>
+
+#include "src/mpi/distributed_batch.h"
+#include "src/utils/cli.h"
+
+int main(int argc, char *argv[]) {
+
+    MPI_Init(&argc, &argv);
+
+    int rank, mpi_size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &mpi_size);
+
+    // Batches are made of many small and medium matrices
+    long count;
+    long parallel_size = 4096;
+    Precision precision = Precision::Double;
+    BenchmarkOptions options;
+    options.dimensions = {256, 512, 1024, 2048};
+    if (!parse_benchmark_options(argc, argv, options) || argc < 2 || !parseLong(argv[1], count) ||
+        (argc > 2 && !parseLong(argv[2], parallel_size)) ||
+        (argc > 3 && !parse_precision(argv[3], precision))) {
+        if (rank == 0)
+            std::cerr << "Usage: " << argv[0] << " <num_matrices> [parallel_size [double|float]] "
+                      << benchmark_usage << std::endl;
+        MPI_Finalize();
+        return 1;
+    }
+    if (options.save) {
+        if (rank == 0)
+            std::cerr << "Invalid argument: the batches do not save their matrices." << std::endl;
+        MPI_Finalize();
+        return 1;
+    }
+    if (!load_tuning_profile(rank == 0)) {
+        MPI_Finalize();
+        return 1;
+    }
+
+    const bool valid = test_distributed_batch(rank, mpi_size, count, parallel_size, precision, options);
+
+    MPI_Finalize();
+
+    return valid ? 0 : 1;
+}
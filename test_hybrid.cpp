@@ -0,0 +1,46 @@
+#include <mpi.h>
+#include <iostream>
+
+#include "src/hybrid/hybrid.h"
+#include "src/utils/cli.h"
+
+int main(int argc, char *argv[]) {
+
+    // Only the main thread makes MPI calls, the FastFlow workers only compute
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+
+    int rank, mpi_size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &mpi_size);
+
+    long maxnw;
+    Partitioning partitioning = Partitioning::Block;
+    int cyclic_block = 1;
+    Precision precision = Precision::Double;
+    BenchmarkOptions options;
+    if (!parse_benchmark_options(argc, argv, options) || argc < 2 || !parseLong(argv[1], maxnw) ||
+        (argc > 2 && !parse_partitioning(argv[2], partitioning, cyclic_block)) ||
+        (argc > 3 && !parse_precision(argv[3], precision))) {
+        if (rank == 0)
+            std::cerr << "Usage: " << argv[0]
+                      << " <num_workers> [block|cyclic[:<rows per block>]|rebalanced|distributed [double|float]] "
+                      << benchmark_usage << std::endl;
+        MPI_Finalize();
+        return 1;
+    }
+    if (!load_tuning_profile(rank == 0)) {
+        MPI_Finalize();
+        return 1;
+    }
+
+    if (provided < MPI_THREAD_FUNNELED && rank == 0) {
+        std::cerr << "Warning: the MPI library does not support MPI_THREAD_FUNNELED." << std::endl;
+    }
+
+    const bool valid = test_hybrid(rank, mpi_size, maxnw, partitioning, cyclic_block, precision, options);
+
+    MPI_Finalize();
+
+    return valid ? 0 : 1;
+}
@@ -0,0 +1,40 @@
+#include "src/openmp/openmp.h"
+#include "src/utils/cli.h"
+#include <iostream>
+#include <string>
+
+int main(int argc, char *argv[]) {
+
+    BenchmarkOptions options;
+    if (!parse_benchmark_options(argc, argv, options) || argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <num_threads> [for|taskloop [double|float]] " << benchmark_usage
+                  << std::endl;
+        return 1;
+    }
+    if (!load_tuning_profile()) {
+        return 1;
+    }
+    long maxnw;
+    OmpLoop loop = OmpLoop::For;
+    Precision precision = Precision::Double;
+
+    if (!parseLong(argv[1], maxnw)) {
+        return 1;
+    }
+    if (argc > 2) {
+        const std::string name{argv[2]};
+        if (name == "taskloop") {
+            loop = OmpLoop::Taskloop;
+        } else if (name != "for") {
+            std::cerr << "Invalid argument: " << argv[2] << " is not a valid loop." << std::endl;
+            return 1;
+        }
+    }
+    if (argc > 3 && !parse_precision(argv[3], precision)) {
+        std::cerr << "Invalid argument: " << argv[3] << " is not a valid precision." << std::endl;
+        return 1;
+    }
+
+    return test_openmp(maxnw, loop, precision, options) ? 0 : 1;
+
+}
@@ -1,32 +1,49 @@
 #include "src/fastflow/parallel.h"
+#include "src/utils/cli.h"
 #include <iostream>
-#include <limits>
+#include <string>
 
-int main(const int argc, char *argv[]) {
+int main(int argc, char *argv[]) {
 
-    if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <num_workers>" << std::endl;
+    BenchmarkOptions options;
+    if (!parse_benchmark_options(argc, argv, options) || argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <num_workers> [tile_size [wavefront|dataflow [double|float "
+                  << "[default|first-touch|interleave|bind]]]] " << benchmark_usage << std::endl;
+        return 1;
+    }
+    if (!load_tuning_profile()) {
         return 1;
     }
     long maxnw;
+    long tile_size = 0;
+    Executor executor = Executor::Wavefront;
+    Precision precision = Precision::Double;
+    NumaPolicy numa_policy = NumaPolicy::Default;
 
-    try {
-        const unsigned long ul_maxnw = std::stoul(argv[1]);
-        if (ul_maxnw > static_cast<unsigned long>(std::numeric_limits<long>::max())) {
-            std::cerr << "Invalid argument: " << argv[1] << " too many workers specified." << std::endl;
+    if (!parseLong(argv[1], maxnw)) {
+        return 1;
+    }
+    if (argc > 2 && !parseLong(argv[2], tile_size)) {
+        return 1;
+    }
+    if (argc > 3) {
+        const std::string name{argv[3]};
+        if (name == "dataflow") {
+            executor = Executor::Dataflow;
+        } else if (name != "wavefront") {
+            std::cerr << "Invalid argument: " << argv[3] << " is not a valid executor." << std::endl;
             return 1;
         }
-        maxnw = static_cast<long>(ul_maxnw);
-    } catch ([[maybe_unused]] const std::invalid_argument &e) {
-        std::cerr << "Invalid argument: " << argv[1] << " is not a valid number." << std::endl;
+    }
+    if (argc > 4 && !parse_precision(argv[4], precision)) {
+        std::cerr << "Invalid argument: " << argv[4] << " is not a valid precision." << std::endl;
         return 1;
-    } catch ([[maybe_unused]] const std::out_of_range &e) {
-        std::cerr << "Invalid argument: " << argv[1] << " is out of range." << std::endl;
+    }
+    if (argc > 5 && !parse_numa_policy(argv[5], numa_policy)) {
+        std::cerr << "Invalid argument: " << argv[5] << " is not a valid NUMA policy." << std::endl;
         return 1;
     }
 
-    test_parallel(maxnw);
-
-    return 0;
+    return test_parallel(maxnw, tile_size, executor, precision, numa_policy, options) ? 0 : 1;
 
-}
\ No newline at end of file
+}
@@ -1,6 +1,19 @@
 #include "src/sequential/sequential.h"
+#include "src/utils/cli.h"
 
-int main() {
-    test_sequential();
-    return 0;
+int main(int argc, char *argv[]) {
+
+    BenchmarkOptions options;
+    long tile_size = 0;
+    Precision precision = Precision::Double;
+    if (!parse_benchmark_options(argc, argv, options) || (argc > 1 && !parseLong(argv[1], tile_size)) ||
+        (argc > 2 && !parse_precision(argv[2], precision))) {
+        std::cerr << "Usage: " << argv[0] << " [tile_size [double|float]] " << benchmark_usage << std::endl;
+        return 1;
+    }
+    if (!load_tuning_profile()) {
+        return 1;
+    }
+
+    return test_sequential(tile_size, precision, options) ? 0 : 1;
 }
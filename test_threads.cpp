@@ -0,0 +1,28 @@
+#include "src/threads/threads.h"
+#include "src/utils/cli.h"
+#include <iostream>
+
+int main(int argc, char *argv[]) {
+
+    BenchmarkOptions options;
+    if (!parse_benchmark_options(argc, argv, options) || argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <num_workers> [double|float] " << benchmark_usage << std::endl;
+        return 1;
+    }
+    if (!load_tuning_profile()) {
+        return 1;
+    }
+    long maxnw;
+    Precision precision = Precision::Double;
+
+    if (!parseLong(argv[1], maxnw)) {
+        return 1;
+    }
+    if (argc > 2 && !parse_precision(argv[2], precision)) {
+        std::cerr << "Invalid argument: " << argv[2] << " is not a valid precision." << std::endl;
+        return 1;
+    }
+
+    return test_threads(maxnw, precision, options) ? 0 : 1;
+
+}